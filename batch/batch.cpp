@@ -0,0 +1,261 @@
+// batch.cpp
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "../pool/pool.h"
+
+using namespace std;
+namespace fs = filesystem;
+
+static const string EXTENSION = ".cfz";
+
+struct BatchFile {
+    fs::path source;
+    fs::path target;
+    uintmax_t size;
+};
+
+static void readInto(const fs::path& path, vector<uint8_t>& buffer, uintmax_t size) {
+    ifstream in(path, ios::binary);
+    if (!in) throw runtime_error("cannot open");
+    buffer.resize(size);
+    in.read(reinterpret_cast<char*>(buffer.data()), size);
+    buffer.resize(static_cast<size_t>(in.gcount()));
+}
+
+static void writeFrom(const fs::path& path, const vector<uint8_t>& buffer) {
+    ofstream out(path, ios::binary);
+    if (!out) throw runtime_error("cannot create");
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!out) throw runtime_error("write failed");
+}
+
+// Общий бюджет памяти партии (--memory-limit): задача резервирует оценку
+// своего пика до начала работы и ждёт, пока другие не вернут достаточно.
+// Каждая оценка не больше всего бюджета, поэтому ожидание конечно.
+class MemoryBudget {
+    mutex mutex_;
+    condition_variable released_;
+    size_t available_;
+
+public:
+    explicit MemoryBudget(size_t limit) : available_(limit) {}
+
+    void acquire(size_t bytes) {
+        unique_lock<mutex> lock(mutex_);
+        released_.wait(lock, [&] { return available_ >= bytes; });
+        available_ -= bytes;
+    }
+
+    void release(size_t bytes) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            available_ += bytes;
+        }
+        released_.notify_all();
+    }
+};
+
+class BudgetReservation {
+    MemoryBudget& budget_;
+    size_t bytes_;
+
+public:
+    BudgetReservation(MemoryBudget& budget, size_t bytes) : budget_(budget), bytes_(bytes) {
+        budget_.acquire(bytes_);
+    }
+    ~BudgetReservation() { budget_.release(bytes_); }
+
+    BudgetReservation(const BudgetReservation&) = delete;
+    BudgetReservation& operator=(const BudgetReservation&) = delete;
+};
+
+// Файл не помещается в память целиком: поток с диска на диск блоками
+static void streamFile(BatchMode mode, const BatchFile& file, const StreamOptions& fileOptions) {
+    ifstream in(file.source, ios::binary);
+    if (!in) throw runtime_error("cannot open");
+    ofstream out(file.target, ios::binary);
+    if (!out) throw runtime_error("cannot create");
+    if (mode == BatchMode::Compress) {
+        compressStream(in, out, fileOptions);
+    } else {
+        decompressStream(in, out, 1, fileOptions.dictionary, fileOptions.memoryLimit);
+    }
+    out.close();
+    if (!out) throw runtime_error("write failed");
+}
+
+// Пик памяти распаковки файла по заголовку его контейнера
+static size_t decompressMemory(const BatchFile& file) {
+    uint8_t header[STREAM_MAX_HEADER_SIZE];
+    ifstream in(file.source, ios::binary);
+    if (!in) throw runtime_error("cannot open");
+    in.read(reinterpret_cast<char*>(header), STREAM_MAX_HEADER_SIZE);
+    StreamInfo info = readStreamInfo(header, static_cast<size_t>(in.gcount()));
+    return streamMemory(findCodec(info.codec), 1, info.blockSize, info.dedupHistory);
+}
+
+static vector<BatchFile> collectBatch(BatchMode mode, const fs::path& src, const fs::path& dst) {
+    if (!fs::is_directory(src)) throw runtime_error("not a directory: " + src.string());
+
+    vector<BatchFile> files;
+    for (const auto& entry : fs::recursive_directory_iterator(src)) {
+        if (!entry.is_regular_file()) continue;
+        fs::path relative = fs::relative(entry.path(), src);
+        fs::path target = dst / relative;
+        if (mode == BatchMode::Compress) {
+            target += EXTENSION;
+        } else {
+            if (entry.path().extension() != EXTENSION) continue;
+            target.replace_extension();
+        }
+        files.push_back({entry.path(), target, entry.file_size()});
+    }
+
+    // Крупные файлы вперёд: хвост партии не ждёт одного большого файла
+    sort(files.begin(), files.end(),
+         [](const BatchFile& a, const BatchFile& b) { return a.size > b.size; });
+    return files;
+}
+
+BatchSummary processDirectory(BatchMode mode, const string& srcDir, const string& dstDir,
+                              const StreamOptions& options) {
+    auto start = chrono::steady_clock::now();
+    vector<BatchFile> files = collectBatch(mode, srcDir, dstDir);
+
+    // Под бюджетом файл сжимается в памяти, только если вместе с
+    // результатом влезает в равную долю потока; иначе идёт потоком
+    // однопоточными блоками, подогнанными под эту долю (или весь бюджет)
+    const size_t limit = options.memoryLimit;
+    StreamOptions fileOptions = options;
+    fileOptions.threads = 1;
+    size_t share = 0;
+    unique_ptr<MemoryBudget> budget;
+    if (limit > 0) {
+        const Codec& codec = findCodec(options.codec);
+        share = limit / max(1u, options.threads);
+        size_t minHistory = options.dedup ? DEDUP_MIN_HISTORY : 0;
+        fileOptions.memoryLimit =
+            streamMemory(codec, 1, STREAM_MIN_BLOCK_SIZE, minHistory) <= share ? share : limit;
+        fileOptions = fitMemoryLimit(fileOptions);
+        fileOptions.memoryLimit = limit;
+        budget.reset(new MemoryBudget(limit));
+    }
+    const Codec& codec = findCodec(options.codec);
+    const size_t history = fileOptions.dedup ? fileOptions.dedupHistory : 0;
+
+    WorkerPool pool(options.threads);
+    vector<CodecContext> contexts(pool.size());
+    // Оценка буферов, которые контекст потока держит после своих файлов
+    vector<size_t> retained(pool.size(), 0);
+    vector<BatchSummary> perWorker(pool.size());
+    mutex errorMutex;
+
+    for (const auto& file : files) {
+        pool.submit([&, file](unsigned worker) {
+            CodecContext& ctx = contexts[worker];
+            BatchSummary& summary = perWorker[worker];
+            summary.files++;
+            unique_ptr<BudgetReservation> reservation;
+            try {
+                if (budget) {
+                    size_t buffered = 2 * file.size + codec.workingMemory(fileOptions.blockSize);
+                    // История не длиннее самого файла, новые фрагменты — не больше блока
+                    if (history > 0) {
+                        buffered += min(file.size, fileOptions.blockSize) +
+                                    dedupMemory(min(history, file.size));
+                    }
+                    bool inMemory = mode == BatchMode::Compress && buffered <= share;
+                    size_t reserved = mode == BatchMode::Decompress ? decompressMemory(file)
+                                    : inMemory ? buffered
+                                    : streamMemory(codec, 1, fileOptions.blockSize, history);
+                    if (reserved > limit) {
+                        throw runtime_error("needs " + to_string(reserved) +
+                                            " bytes, over the memory limit");
+                    }
+                    // Буферы прошлых файлов входят в резерв: в памяти они
+                    // переиспользуются, при потоковой обработке лежат рядом.
+                    // Контекст сбрасывается, только если вместе не влезают
+                    size_t withContext = inMemory ? max(reserved, retained[worker])
+                                                  : reserved + retained[worker];
+                    if (withContext > limit) {
+                        ctx = CodecContext();
+                        retained[worker] = 0;
+                        withContext = reserved;
+                    }
+                    reservation.reset(new BudgetReservation(*budget, withContext));
+                    if (inMemory) retained[worker] = max(retained[worker], buffered);
+
+                    if (!inMemory) {
+                        error_code ec;
+                        fs::create_directories(file.target.parent_path(), ec);
+                        streamFile(mode, file, fileOptions);
+                        summary.inputBytes += file.size;
+                        summary.outputBytes += fs::file_size(file.target);
+                        return;
+                    }
+                }
+
+                readInto(file.source, ctx.input, file.size);
+                ctx.output.clear();
+                if (mode == BatchMode::Compress) {
+                    compressBuffer(ctx.input.data(), ctx.input.size(), ctx.output, fileOptions, ctx);
+                } else {
+                    decompressBuffer(ctx.input.data(), ctx.input.size(), ctx.output,
+                                     options.dictionary);
+                }
+
+                error_code ec;
+                fs::create_directories(file.target.parent_path(), ec);
+                writeFrom(file.target, ctx.output);
+
+                summary.inputBytes += ctx.input.size();
+                summary.outputBytes += ctx.output.size();
+            } catch (const exception& e) {
+                summary.failed++;
+                lock_guard<mutex> lock(errorMutex);
+                cerr << file.source.string() << ": " << e.what() << "\n";
+            }
+        });
+    }
+    pool.wait();
+
+    BatchSummary total;
+    for (const auto& s : perWorker) {
+        total.files += s.files;
+        total.failed += s.failed;
+        total.inputBytes += s.inputBytes;
+        total.outputBytes += s.outputBytes;
+    }
+    total.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+void printBatchSummary(ostream& out, BatchMode mode, const BatchSummary& s) {
+    const double MiB = 1024.0 * 1024.0;
+    double seconds = max(s.wallMs / 1000.0, 1e-9);
+    // Степень сжатия всегда считается от несжатого объёма
+    uint64_t rawBytes = mode == BatchMode::Compress ? s.inputBytes : s.outputBytes;
+    uint64_t packedBytes = mode == BatchMode::Compress ? s.outputBytes : s.inputBytes;
+
+    out << fixed << setprecision(2)
+        << "files: " << s.files << " (" << s.failed << " failed)\n"
+        << "input_mib: " << s.inputBytes / MiB << "\n"
+        << "output_mib: " << s.outputBytes / MiB << "\n"
+        << "ratio_percent: "
+        << (rawBytes ? (1.0 - static_cast<double>(packedBytes) / rawBytes) * 100.0 : 0.0) << "\n"
+        << "wall_s: " << setprecision(3) << seconds << "\n"
+        << "throughput_mib_s: " << setprecision(2) << rawBytes / MiB / seconds << "\n"
+        << "files_per_s: " << s.files / seconds << "\n";
+}
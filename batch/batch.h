@@ -0,0 +1,33 @@
+// batch.h
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "../stream/stream.h"
+
+enum class BatchMode {
+    Compress,
+    Decompress
+};
+
+struct BatchSummary {
+    uint64_t files = 0;
+    uint64_t failed = 0;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    double wallMs = 0;
+};
+
+// Обходит srcDir и сжимает каждый файл в dstDir/<путь>.cfz (или
+// распаковывает *.cfz обратно) в пуле из options.threads потоков.
+// Контекст кодека у каждого потока свой и переиспользуется между
+// файлами. С options.memoryLimit каждый файл заранее резервирует оценку
+// своего пика в общем бюджете, а файлы, не помещающиеся в память
+// целиком, идут потоком с диска на диск. Ошибки отдельных файлов
+// печатаются в stderr и считаются в failed.
+BatchSummary processDirectory(BatchMode mode, const std::string& srcDir,
+                              const std::string& dstDir, const StreamOptions& options);
+
+void printBatchSummary(std::ostream& out, BatchMode mode, const BatchSummary& summary);
@@ -0,0 +1,358 @@
+// bwt.cpp
+#include "bwt.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "../stats/stats.h"
+
+using namespace std;
+
+// Символы после MTF: две цифры длины серии нулей, ранги 1..253 со сдвигом
+// на единицу и escape для редких старших рангов (за ним байт ранга)
+const uint8_t RUNA = 0;
+const uint8_t RUNB = 1;
+const uint8_t RANK_ESCAPE = 255;
+const size_t MIN_BLOCK = 64;      // Меньшие блоки хранятся как есть ('U')
+const size_t HEADER_SIZE = 9;     // 'B', размер, номер строки исходного текста
+
+static void putU32(vector<uint8_t>& out, uint32_t v) {
+    for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<uint8_t>(v >> shift));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// SA-IS (Nong, Zhang, Chan): суффиксы делятся на S- и L-типы, LMS-суффиксы
+// сортируются рекурсивно на сжатой строке, остальные выводятся индукцией
+// за два прохода по корзинам. Конец строки меньше любого символа.
+// s[i] лежат в [0, upper].
+template <typename Symbol>
+static void suffixSort(const Symbol* s, int32_t n, int32_t upper, int32_t* sa) {
+    if (n == 0) return;
+    if (n == 1) {
+        sa[0] = 0;
+        return;
+    }
+    if (n == 2) {
+        sa[0] = s[0] < s[1] ? 0 : 1;
+        sa[1] = 1 - sa[0];
+        return;
+    }
+
+    // isS[i]: суффикс i меньше суффикса i + 1
+    vector<uint8_t> isS(n, 0);
+    for (int32_t i = n - 2; i >= 0; --i) {
+        isS[i] = s[i] == s[i + 1] ? isS[i + 1] : s[i] < s[i + 1];
+    }
+
+    // Начала L-части (sumL) и S-части (sumS) каждой корзины
+    vector<int32_t> sumL(upper + 2, 0), sumS(upper + 2, 0);
+    for (int32_t i = 0; i < n; ++i) {
+        if (!isS[i]) sumS[s[i]]++;
+        else sumL[s[i] + 1]++;
+    }
+    for (int32_t c = 0; c <= upper; ++c) {
+        sumS[c] += sumL[c];
+        sumL[c + 1] += sumS[c];
+    }
+
+    vector<int32_t> bucket(upper + 2);
+    auto induce = [&](const vector<int32_t>& lms) {
+        fill(sa, sa + n, -1);
+        copy(sumS.begin(), sumS.end(), bucket.begin());
+        for (int32_t d : lms) {
+            sa[bucket[s[d]]++] = d;
+        }
+        copy(sumL.begin(), sumL.end(), bucket.begin());
+        sa[bucket[s[n - 1]]++] = n - 1;
+        for (int32_t i = 0; i < n; ++i) {
+            int32_t v = sa[i];
+            if (v >= 1 && !isS[v - 1]) sa[bucket[s[v - 1]]++] = v - 1;
+        }
+        copy(sumL.begin(), sumL.end(), bucket.begin());
+        for (int32_t i = n - 1; i >= 0; --i) {
+            int32_t v = sa[i];
+            if (v >= 1 && isS[v - 1]) sa[--bucket[s[v - 1] + 1]] = v - 1;
+        }
+    };
+
+    vector<int32_t> lmsIndex(n + 1, -1);
+    vector<int32_t> lms;
+    for (int32_t i = 1; i < n; ++i) {
+        if (!isS[i - 1] && isS[i]) {
+            lmsIndex[i] = static_cast<int32_t>(lms.size());
+            lms.push_back(i);
+        }
+    }
+    const int32_t m = static_cast<int32_t>(lms.size());
+
+    induce(lms);
+    if (m == 0) return;
+
+    // Имена LMS-подстрок в порядке индукции; равные подстроки — одно имя
+    vector<int32_t> sortedLms;
+    sortedLms.reserve(m);
+    for (int32_t i = 0; i < n; ++i) {
+        if (lmsIndex[sa[i]] != -1) sortedLms.push_back(sa[i]);
+    }
+    vector<int32_t> reduced(m);
+    int32_t name = 0;
+    reduced[lmsIndex[sortedLms[0]]] = 0;
+    for (int32_t i = 1; i < m; ++i) {
+        int32_t l = sortedLms[i - 1], r = sortedLms[i];
+        int32_t endL = lmsIndex[l] + 1 < m ? lms[lmsIndex[l] + 1] : n;
+        int32_t endR = lmsIndex[r] + 1 < m ? lms[lmsIndex[r] + 1] : n;
+        bool same = endL - l == endR - r;
+        if (same) {
+            while (l < endL && s[l] == s[r]) {
+                ++l;
+                ++r;
+            }
+            if (l == n || s[l] != s[r]) same = false;
+        }
+        if (!same) ++name;
+        reduced[lmsIndex[sortedLms[i]]] = name;
+    }
+
+    vector<int32_t> reducedSa(m);
+    suffixSort(reduced.data(), m, name, reducedSa.data());
+    for (int32_t i = 0; i < m; ++i) {
+        sortedLms[i] = lms[reducedSa[i]];
+    }
+    induce(sortedLms);
+}
+
+// Последний столбец отсортированных циклических сдвигов data + '$' без
+// самого '$'; возвращает строку, где он стоял
+static uint32_t forwardTransform(const uint8_t* data, size_t size, BWTContext& ctx,
+                                 BWTStats& stats) {
+    vector<int32_t>& sa = ctx.suffixes;
+    sa.resize(size);
+    {
+        StageTimer t(stats.sortMs);
+        suffixSort(data, static_cast<int32_t>(size), 255, sa.data());
+    }
+
+    // Строка 0 — сдвиг, начинающийся с '$'; строка j + 1 — суффикс sa[j]
+    vector<uint8_t>& last = ctx.transformed;
+    last.resize(size);
+    last[0] = data[size - 1];
+    uint32_t primary = 0;
+    size_t w = 1;
+    for (size_t j = 0; j < size; ++j) {
+        if (sa[j] == 0) {
+            primary = static_cast<uint32_t>(j + 1);
+        } else {
+            last[w++] = data[sa[j] - 1];
+        }
+    }
+    return primary;
+}
+
+// Длина серии нулей в биективной двоичной записи младшими цифрами вперёд
+static void putZeroRun(vector<uint8_t>& symbols, size_t run) {
+    while (run > 0) {
+        if (run & 1) {
+            symbols.push_back(RUNA);
+            run = (run - 1) / 2;
+        } else {
+            symbols.push_back(RUNB);
+            run = (run - 2) / 2;
+        }
+    }
+}
+
+static void moveToFront(const vector<uint8_t>& last, vector<uint8_t>& symbols, BWTStats& stats) {
+    uint8_t order[256];
+    for (int c = 0; c < 256; ++c) order[c] = static_cast<uint8_t>(c);
+
+    symbols.clear();
+    symbols.reserve(last.size());
+    size_t run = 0;
+    for (uint8_t c : last) {
+        if (order[0] == c) {
+            ++run;
+            continue;
+        }
+        if (run > 0) {
+            putZeroRun(symbols, run);
+            ++stats.zeroRuns;
+            run = 0;
+        }
+
+        size_t rank = 1;
+        while (order[rank] != c) ++rank;
+        copy_backward(order, order + rank, order + rank + 1);
+        order[0] = c;
+
+        if (rank < RANK_ESCAPE - 1) {
+            symbols.push_back(static_cast<uint8_t>(rank + 1));
+        } else {
+            symbols.push_back(RANK_ESCAPE);
+            symbols.push_back(static_cast<uint8_t>(rank));
+        }
+    }
+    if (run > 0) {
+        putZeroRun(symbols, run);
+        ++stats.zeroRuns;
+    }
+}
+
+void bwtCompress(const uint8_t* data, size_t size, vector<uint8_t>& out, BWTContext* context) {
+    if (size < MIN_BLOCK || size > size_t(INT32_MAX)) {
+        out.push_back('U'); // Маркер несжатого блока
+        out.insert(out.end(), data, data + size);
+        return;
+    }
+
+    BWTContext local;
+    BWTContext& ctx = context ? *context : local;
+    BWTStats stats;
+    stats.bytes = size;
+
+    uint32_t primary = forwardTransform(data, size, ctx, stats);
+    {
+        StageTimer t(stats.mtfMs);
+        moveToFront(ctx.transformed, ctx.symbols, stats);
+    }
+    stats.symbols = ctx.symbols.size();
+
+    out.push_back('B');
+    putU32(out, static_cast<uint32_t>(size));
+    putU32(out, primary);
+    huffmanCompress(ctx.symbols.data(), ctx.symbols.size(), out, nullptr, &ctx.huffman);
+    recordStats(stats);
+}
+
+// Обратные MTF и серии нулей; false — символы не дают ровно size байт
+static bool inverseMoveToFront(const vector<uint8_t>& symbols, size_t size, vector<uint8_t>& last) {
+    uint8_t order[256];
+    for (int c = 0; c < 256; ++c) order[c] = static_cast<uint8_t>(c);
+
+    last.clear();
+    last.reserve(size);
+    size_t run = 0;
+    int digit = 0;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        uint8_t sym = symbols[i];
+        if (sym == RUNA || sym == RUNB) {
+            if (digit >= 40) return false;
+            run += size_t(sym == RUNA ? 1 : 2) << digit;
+            ++digit;
+            if (run > size - last.size()) return false;
+            continue;
+        }
+        if (run > 0) {
+            last.insert(last.end(), run, order[0]);
+            run = 0;
+            digit = 0;
+        }
+
+        size_t rank = sym - 1;
+        if (sym == RANK_ESCAPE) {
+            if (++i == symbols.size()) return false;
+            rank = symbols[i];
+            if (rank == 0) return false;
+        }
+        uint8_t c = order[rank];
+        copy_backward(order, order + rank, order + rank + 1);
+        order[0] = c;
+        if (last.size() == size) return false;
+        last.push_back(c);
+    }
+    last.insert(last.end(), run, order[0]);
+    return last.size() == size;
+}
+
+bool bwtDecompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t expectedSize) {
+    if (size == 0) return false;
+    if (data[0] == 'U') {
+        if (expectedSize != CODEC_UNKNOWN_SIZE && size - 1 != expectedSize) return false;
+        out.insert(out.end(), data + 1, data + size);
+        return true;
+    }
+    if (data[0] != 'B' || size < HEADER_SIZE) return false;
+
+    // Размер из блока проверяется до выделения next[] и результата
+    const size_t rawSize = getU32(data + 1);
+    const size_t primary = getU32(data + 5);
+    if (rawSize == 0 || primary == 0 || primary > rawSize) return false;
+    if (expectedSize != CODEC_UNKNOWN_SIZE && rawSize != expectedSize) return false;
+
+    BWTStats stats;
+    vector<uint8_t> symbols;
+    // Байт даёт не больше двух символов (ранг с экранированием),
+    // серия нулей — меньше символов, чем её длина
+    if (!huffmanDecompressBounded(data + HEADER_SIZE, size - HEADER_SIZE, symbols, 2 * rawSize)) {
+        return false;
+    }
+
+    vector<uint8_t> last;
+    {
+        StageTimer t(stats.mtfMs);
+        if (!inverseMoveToFront(symbols, rawSize, last)) return false;
+    }
+
+    {
+        StageTimer t(stats.inverseMs);
+        // Строки r < primary хранят last[r], строки r > primary — last[r - 1];
+        // строка primary — сам '$'. next[r] — строка сдвига, который начинается
+        // с последнего символа строки r (LF-отображение)
+        const size_t rows = rawSize + 1;
+        size_t starts[256];
+        size_t counts[256] = {};
+        for (uint8_t c : last) counts[c]++;
+        size_t sum = 1; // Строка 0 начинается с '$'
+        for (int c = 0; c < 256; ++c) {
+            starts[c] = sum;
+            sum += counts[c];
+        }
+
+        vector<uint32_t> next(rows);
+        next[primary] = 0;
+        for (size_t r = 0, w = 0; r < rows; ++r) {
+            if (r == primary) continue;
+            next[r] = static_cast<uint32_t>(starts[last[w++]]++);
+        }
+
+        const size_t base = out.size();
+        out.resize(base + rawSize);
+        size_t row = 0;
+        for (size_t k = rawSize; k-- > 0;) {
+            out[base + k] = last[row < primary ? row : row - 1];
+            row = next[row];
+        }
+    }
+
+    stats.bytes = rawSize;
+    stats.symbols = symbols.size();
+    recordStats(stats);
+    return true;
+}
+
+// Словарь не используется: контекст строится внутри блока
+class BWTCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::BWT; }
+    const char* name() const override { return "BWT"; }
+
+    void compress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                  const CodecParams&, CodecContext* context) const override {
+        bwtCompress(data, size, out, context ? &context->scratch<BWTContext>(id()) : nullptr);
+    }
+
+    bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize,
+                    const CodecParams&) const override {
+        return bwtDecompress(data, size, out, rawSize);
+    }
+
+    // SA-IS с рекурсией (до ~20 байт на символ), затем BWT, MTF и Хаффман;
+    // обратное преобразование заметно дешевле (~7 байт на символ)
+    size_t workingMemory(size_t blockSize) const override {
+        return 27 * blockSize + (size_t(64) << 10);
+    }
+};
+
+static CodecRegistration<BWTCodec> registerBWT;
@@ -0,0 +1,29 @@
+// bwt.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../codec/codec.h"
+#include "../huffman/huffman.h"
+
+// Буферы блочной сортировки, переиспользуемые между блоками одного потока
+struct BWTContext : CodecScratch {
+    std::vector<int32_t> suffixes;   // Суффиксный массив блока
+    std::vector<uint8_t> transformed; // Последний столбец BWT
+    std::vector<uint8_t> symbols;     // MTF + серии нулей для Хаффмана
+    HuffmanContext huffman;
+};
+
+// Блочная сортировка: преобразование Барроуза — Уилера (суффиксный массив
+// SA-IS за O(n)), move-to-front, кодирование серий нулей RUNA/RUNB и
+// Хаффман. Учитывает контекст любого порядка в пределах блока; блоки
+// независимы и сжимаются параллельно в пуле потокового контейнера.
+// Результат дописывается в конец out.
+void bwtCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                 BWTContext* context = nullptr);
+// Распаковка блока; false — повреждённые данные или размер блока не
+// равен rawSize (проверяется до выделения памяти под обратное преобразование)
+bool bwtDecompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                   size_t rawSize = CODEC_UNKNOWN_SIZE);
@@ -0,0 +1,43 @@
+// codec.cpp
+#include "codec.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+using namespace std;
+
+static string lowercase(string s) {
+    transform(s.begin(), s.end(), s.begin(),
+              [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return s;
+}
+
+CodecRegistry& CodecRegistry::instance() {
+    static CodecRegistry registry;
+    return registry;
+}
+
+void CodecRegistry::add(unique_ptr<Codec> codec) {
+    if (find(codec->id()) || find(codec->name())) {
+        throw logic_error(string("codec registered twice: ") + codec->name());
+    }
+    auto pos = upper_bound(codecs_.begin(), codecs_.end(), codec->id(),
+                           [](CodecId id, const unique_ptr<Codec>& c) { return id < c->id(); });
+    codecs_.insert(pos, move(codec));
+}
+
+const Codec* CodecRegistry::find(CodecId id) const {
+    for (const auto& codec : codecs_) {
+        if (codec->id() == id) return codec.get();
+    }
+    return nullptr;
+}
+
+const Codec* CodecRegistry::find(const string& name) const {
+    string wanted = lowercase(name);
+    for (const auto& codec : codecs_) {
+        if (lowercase(codec->name()) == wanted) return codec.get();
+    }
+    return nullptr;
+}
@@ -0,0 +1,111 @@
+// codec.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Dictionary;
+
+// Идентификатор кодека в заголовке контейнера
+enum class CodecId : uint8_t {
+    Huffman = 1,
+    LZ77 = 2,
+    RLE = 3,
+    Rans = 4,
+    LZ77Wide = 5,
+    RLE16 = 6,
+    BWT = 7
+};
+
+const int CODEC_MIN_LEVEL = 1;
+const int CODEC_MAX_LEVEL = 9;
+const int CODEC_DEFAULT_LEVEL = 6;
+
+// Размер результата распаковки не известен заранее (файловые утилиты
+// без контейнера); тогда ядро доверяет размеру из самого блока
+const size_t CODEC_UNKNOWN_SIZE = SIZE_MAX;
+
+struct CodecParams {
+    int level = CODEC_DEFAULT_LEVEL;
+    const Dictionary* dictionary = nullptr; // Обученный словарь (-D)
+};
+
+// Таблицы кодека, переживающие один блок; хранятся в CodecContext
+struct CodecScratch {
+    virtual ~CodecScratch() = default;
+};
+
+// Буферы и таблицы одного исполнителя; живут дольше одного блока или
+// файла, чтобы не перевыделять окна, хеш-цепочки и гистограммы
+struct CodecContext {
+    std::vector<uint8_t> input;   // Прочитанный файл (пакетный режим)
+    std::vector<uint8_t> output;  // Результат для записи
+    std::vector<uint8_t> packed;  // Сжатый блок
+
+    // Состояние кодека id, создаётся при первом обращении
+    template <typename T>
+    T& scratch(CodecId id) {
+        std::unique_ptr<CodecScratch>& slot = scratch_[static_cast<uint8_t>(id)];
+        if (!slot) slot.reset(new T());
+        return static_cast<T&>(*slot);
+    }
+
+private:
+    std::unordered_map<uint8_t, std::unique_ptr<CodecScratch>> scratch_;
+};
+
+// Кодек блока в памяти. Результат дописывается в конец out;
+// decompress возвращает false на повреждённых данных. rawSize — размер
+// блока из кадра контейнера: out растёт не больше чем на rawSize байт,
+// а блок, дающий другой размер, отвергается до выделения памяти под него.
+class Codec {
+public:
+    virtual ~Codec() = default;
+
+    virtual CodecId id() const = 0;
+    virtual const char* name() const = 0;
+
+    virtual void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                          const CodecParams& params, CodecContext* context) const = 0;
+    virtual bool decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                            size_t rawSize, const CodecParams& params) const = 0;
+
+    // Оценка пика кучи на один блок из blockSize байт (сжатие или
+    // распаковка, что больше): таблицы и результат, без самого входа.
+    // По ней поток подбирает размер блока и число потоков под --memory-limit.
+    virtual size_t workingMemory(size_t blockSize) const = 0;
+
+    // Читает ли кодек CodecParams::dictionary. Без этого поток не пишет
+    // флаг словаря и не требует -D при распаковке.
+    virtual bool usesDictionary() const { return false; }
+};
+
+// Реестр кодеков: id из заголовка контейнера и имя из CLI -> кодек.
+// Кодеки регистрируются сами (CodecRegistration), main.cpp о них не знает.
+class CodecRegistry {
+    std::vector<std::unique_ptr<Codec>> codecs_;
+
+public:
+    static CodecRegistry& instance();
+
+    // std::logic_error при повторе id или имени
+    void add(std::unique_ptr<Codec> codec);
+
+    const Codec* find(CodecId id) const;
+    // Имя без учёта регистра
+    const Codec* find(const std::string& name) const;
+    // По возрастанию id
+    const std::vector<std::unique_ptr<Codec>>& all() const { return codecs_; }
+};
+
+// Статический объект этого типа в .cpp кодека добавляет его в реестр
+template <typename T>
+struct CodecRegistration {
+    CodecRegistration() {
+        CodecRegistry::instance().add(std::unique_ptr<Codec>(new T()));
+    }
+};
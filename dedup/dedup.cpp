@@ -0,0 +1,153 @@
+// dedup.cpp
+#include "dedup.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+// Маски FastCDC с нормализацией: до средней длины граница ставится
+// реже (больше бит), после — чаще, поэтому длины кучнее около средней.
+// Берутся старшие биты: после сдвигов они зависят от последних 64 байт.
+static const uint64_t MASK_SMALL = ((uint64_t(1) << 15) - 1) << 49;
+static const uint64_t MASK_LARGE = ((uint64_t(1) << 11) - 1) << 53;
+
+struct GearTable {
+    uint64_t values[256];
+
+    GearTable() {
+        // splitmix64 с фиксированным зерном: таблица — часть формата
+        uint64_t seed = 0x2545F4914F6CDD1Dull;
+        for (auto& v : values) {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            v = z ^ (z >> 31);
+        }
+    }
+};
+
+static const GearTable GEAR;
+
+size_t dedupCutPoint(const uint8_t* data, size_t size) {
+    if (size <= DEDUP_MIN_CHUNK) return size;
+    size_t normal = min(size, DEDUP_AVG_CHUNK);
+    size_t limit = min(size, DEDUP_MAX_CHUNK);
+
+    // Первые DEDUP_MIN_CHUNK байт не хэшируются: граница там не ставится
+    uint64_t hash = 0;
+    size_t i = DEDUP_MIN_CHUNK;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + GEAR.values[data[i]];
+        if (!(hash & MASK_SMALL)) return i + 1;
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + GEAR.values[data[i]];
+        if (!(hash & MASK_LARGE)) return i + 1;
+    }
+    return limit;
+}
+
+// Отпечаток фрагмента: 64-битный хэш по словам. Совпадение отпечатков
+// перепроверяется сравнением байт, поэтому стойкость к коллизиям не нужна.
+static uint64_t fingerprint(const uint8_t* data, size_t size) {
+    const uint64_t MUL = 0xFF51AFD7ED558CCDull;
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        h = (h ^ w) * MUL;
+        h ^= h >> 32;
+    }
+    if (i < size) {
+        uint64_t w = 0;
+        memcpy(&w, data + i, size - i);
+        h = (h ^ w) * MUL;
+    }
+    h ^= h >> 29;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 32);
+}
+
+uint32_t DedupHistory::append(uint64_t fingerprint, const uint8_t* data, size_t size) {
+    uint32_t id = firstId_ + static_cast<uint32_t>(chunks_.size());
+    if (id >= DEDUP_REF_FLAG) throw runtime_error("too many dedup chunks in one stream");
+    chunks_.push_back({fingerprint, vector<uint8_t>(data, data + size)});
+    bytes_ += size;
+
+    // Последний фрагмент остаётся, даже если он один больше истории
+    while (bytes_ > limit_ && chunks_.size() > 1) {
+        evicted(firstId_, chunks_.front());
+        bytes_ -= chunks_.front().data.size();
+        chunks_.pop_front();
+        ++firstId_;
+    }
+    return id;
+}
+
+const DedupHistory::Entry* DedupHistory::entry(uint32_t id) const {
+    if (id < firstId_ || id - firstId_ >= chunks_.size()) return nullptr;
+    return &chunks_[id - firstId_];
+}
+
+void DedupEncoder::evicted(uint32_t id, const Entry& e) {
+    auto it = index_.find(e.fingerprint);
+    if (it != index_.end() && it->second == id) index_.erase(it);
+}
+
+void DedupEncoder::encode(const uint8_t* data, size_t size, vector<uint32_t>& recipe,
+                          vector<uint8_t>& unique, DedupStats& stats) {
+    for (size_t pos = 0; pos < size;) {
+        size_t len;
+        uint64_t fp;
+        {
+            StageTimer t(stats.chunkMs);
+            len = dedupCutPoint(data + pos, size - pos);
+            fp = fingerprint(data + pos, len);
+        }
+
+        StageTimer t(stats.indexMs);
+        const uint8_t* chunk = data + pos;
+        ++stats.chunks;
+        stats.bytes += len;
+        pos += len;
+
+        auto it = index_.find(fp);
+        if (it != index_.end()) {
+            const Entry* e = entry(it->second);
+            if (e && e->data.size() == len && memcmp(e->data.data(), chunk, len) == 0) {
+                recipe.push_back(DEDUP_REF_FLAG | it->second);
+                ++stats.duplicates;
+                stats.duplicateBytes += len;
+                continue;
+            }
+        }
+
+        recipe.push_back(static_cast<uint32_t>(len));
+        unique.insert(unique.end(), chunk, chunk + len);
+        // При коллизии отпечатка индекс указывает на новый фрагмент
+        index_[fp] = append(fp, chunk, len);
+    }
+}
+
+bool DedupDecoder::decode(const uint32_t* recipe, size_t count, const uint8_t* unique,
+                          size_t uniqueSize, vector<uint8_t>& out) {
+    size_t pos = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v = recipe[i];
+        if (v & DEDUP_REF_FLAG) {
+            const Entry* e = entry(v & ~DEDUP_REF_FLAG);
+            if (!e) return false;
+            out.insert(out.end(), e->data.begin(), e->data.end());
+        } else {
+            if (v == 0 || v > DEDUP_MAX_CHUNK || uniqueSize - pos < v) return false;
+            const uint8_t* chunk = unique + pos;
+            out.insert(out.end(), chunk, chunk + v);
+            // Отпечаток декодеру не нужен: ищут только по номеру
+            append(0, chunk, v);
+            pos += v;
+        }
+    }
+    return pos == uniqueSize;
+}
@@ -0,0 +1,92 @@
+// dedup.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "../stats/stats.h"
+
+// Дедупликация перед кодеком: вход режется на фрагменты по содержимому
+// (Gear/FastCDC), повтор уже виденного фрагмента заменяется ссылкой на
+// его номер. Кодеку передаются только новые фрагменты. Номера и история
+// фрагментов общие для всего потока, поэтому повторы находятся на любом
+// расстоянии в пределах истории, а не только в окне LZ77.
+
+// Границы длины фрагмента (средняя — около DEDUP_AVG_CHUNK)
+const size_t DEDUP_MIN_CHUNK = size_t(2) << 10;
+const size_t DEDUP_AVG_CHUNK = size_t(8) << 10;
+const size_t DEDUP_MAX_CHUNK = size_t(64) << 10;
+
+// История по умолчанию и минимум, до которого её урезает --memory-limit
+const size_t DEDUP_DEFAULT_HISTORY = size_t(64) << 20;
+const size_t DEDUP_MIN_HISTORY = size_t(4) << 20;
+
+// Запись рецепта блока: старший бит — ссылка на номер фрагмента,
+// иначе длина нового фрагмента, байты которого идут в кодек
+const uint32_t DEDUP_REF_FLAG = 0x80000000u;
+
+// Верхняя граница числа записей рецепта для блока из size байт
+inline size_t dedupMaxEntries(size_t size) {
+    return size / DEDUP_MIN_CHUNK + 1;
+}
+
+// Оценка памяти истории и индекса для history байт истории
+inline size_t dedupMemory(size_t history) {
+    return history + history / 16;
+}
+
+// Длина первого фрагмента data[0..size)
+size_t dedupCutPoint(const uint8_t* data, size_t size);
+
+// История фрагментов: хранит последние history байт новых фрагментов.
+// Кодер и декодер вытесняют их одинаково, поэтому номера совпадают.
+class DedupHistory {
+public:
+    explicit DedupHistory(size_t history) : limit_(history) {}
+
+protected:
+    struct Entry {
+        uint64_t fingerprint;
+        std::vector<uint8_t> data;
+    };
+
+    // Добавляет фрагмент; возвращает его номер
+    uint32_t append(uint64_t fingerprint, const uint8_t* data, size_t size);
+    // nullptr, если номера ещё нет или фрагмент вытеснен
+    const Entry* entry(uint32_t id) const;
+    // Вызывается для каждого вытесненного фрагмента
+    virtual void evicted(uint32_t, const Entry&) {}
+
+private:
+    std::deque<Entry> chunks_;
+    uint32_t firstId_ = 0;
+    size_t bytes_ = 0;
+    size_t limit_;
+};
+
+class DedupEncoder : public DedupHistory {
+public:
+    explicit DedupEncoder(size_t history) : DedupHistory(history) {}
+
+    // Режет блок на фрагменты: рецепт дописывается в recipe,
+    // байты новых фрагментов — в unique
+    void encode(const uint8_t* data, size_t size, std::vector<uint32_t>& recipe,
+                std::vector<uint8_t>& unique, DedupStats& stats);
+
+private:
+    void evicted(uint32_t id, const Entry& e) override;
+
+    std::unordered_map<uint64_t, uint32_t> index_; // Отпечаток -> последний номер
+};
+
+class DedupDecoder : public DedupHistory {
+public:
+    explicit DedupDecoder(size_t history) : DedupHistory(history) {}
+
+    // Собирает блок по рецепту, дописывая его в out; false — повреждённые данные
+    bool decode(const uint32_t* recipe, size_t count, const uint8_t* unique,
+                size_t uniqueSize, std::vector<uint8_t>& out);
+};
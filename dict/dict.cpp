@@ -0,0 +1,189 @@
+// dict.cpp
+#include "dict.h"
+
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+static const uint8_t DICT_MAGIC[4] = {'C', 'F', 'Z', 'D'};
+static const size_t KMER_LEN = 6;       // Длина подстроки при подсчёте покрытия
+static const size_t SEGMENT_LEN = 64;   // Длина кандидата в префикс
+static const size_t SEGMENT_STEP = 16;  // Шаг между кандидатами в образце
+
+struct KmerInfo {
+    uint32_t samples = 0;       // В скольких образцах встречается
+    uint32_t lastSample = ~0u;  // Чтобы считать образец один раз
+    bool covered = false;       // Уже есть в выбранных сегментах
+};
+
+static inline uint64_t kmerKey(const uint8_t* p) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < KMER_LEN; ++i) key = (key << 8) | p[i];
+    return key;
+}
+
+struct Segment {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Ценность сегмента: сколько образцов разделяют его ещё не покрытые подстроки
+static uint64_t scoreSegment(const Segment& seg, const unordered_map<uint64_t, KmerInfo>& kmers,
+                             vector<uint64_t>& scratch) {
+    scratch.clear();
+    for (size_t i = 0; i + KMER_LEN <= seg.size; ++i) {
+        scratch.push_back(kmerKey(seg.data + i));
+    }
+    sort(scratch.begin(), scratch.end());
+    scratch.erase(unique(scratch.begin(), scratch.end()), scratch.end());
+
+    uint64_t score = 0;
+    for (uint64_t key : scratch) {
+        const KmerInfo& info = kmers.at(key);
+        // Подстрока из одного образца другим записям не поможет
+        if (!info.covered && info.samples >= 2) score += info.samples;
+    }
+    return score;
+}
+
+static uint32_t dictionaryId(const Dictionary& dict) {
+    // FNV-1a по префиксу и частотам
+    uint32_t hash = 2166136261u;
+    auto mix = [&](uint8_t byte) {
+        hash ^= byte;
+        hash *= 16777619u;
+    };
+    for (uint8_t b : dict.content) mix(b);
+    for (uint32_t f : dict.frequencies) {
+        for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(f >> shift));
+    }
+    return hash ? hash : 1;
+}
+
+Dictionary trainDictionary(const vector<vector<uint8_t>>& samples, size_t maxContentSize) {
+    Dictionary dict;
+
+    // Статическая таблица: общая гистограмма, каждый символ хотя бы раз,
+    // иначе запись с неожиданным байтом нельзя было бы закодировать
+    uint64_t counts[256] = {};
+    uint64_t total = 0;
+    for (const auto& sample : samples) {
+        for (uint8_t c : sample) counts[c]++;
+        total += sample.size();
+    }
+    int shift = 0;
+    while (((total >> shift) + 256) >= (uint64_t(1) << 24)) ++shift;
+    for (int c = 0; c < 256; ++c) {
+        dict.frequencies[c] = static_cast<uint32_t>((counts[c] >> shift) + 1);
+    }
+
+    // Префикс LZ77: жадный выбор сегментов, покрывающих подстроки,
+    // общие для наибольшего числа образцов
+    unordered_map<uint64_t, KmerInfo> kmers;
+    vector<Segment> segments;
+    for (uint32_t s = 0; s < samples.size(); ++s) {
+        const auto& sample = samples[s];
+        for (size_t i = 0; i + KMER_LEN <= sample.size(); ++i) {
+            KmerInfo& info = kmers[kmerKey(sample.data() + i)];
+            if (info.lastSample != s) {
+                info.lastSample = s;
+                info.samples++;
+            }
+        }
+        for (size_t i = 0; i < sample.size(); i += SEGMENT_STEP) {
+            size_t len = min(SEGMENT_LEN, sample.size() - i);
+            if (len >= KMER_LEN) segments.push_back({sample.data() + i, len});
+            if (i + SEGMENT_LEN >= sample.size()) break;
+        }
+    }
+
+    vector<uint64_t> scratch;
+    priority_queue<pair<uint64_t, size_t>> queue;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        uint64_t score = scoreSegment(segments[i], kmers, scratch);
+        if (score > 0) queue.push({score, i});
+    }
+
+    // Оценки только убывают, поэтому достаточно пересчитывать вершину
+    vector<size_t> chosen;
+    size_t contentSize = 0;
+    while (!queue.empty() && contentSize < maxContentSize) {
+        auto top = queue.top();
+        queue.pop();
+        uint64_t score = scoreSegment(segments[top.second], kmers, scratch);
+        if (score == 0) continue;
+        if (score < top.first) {
+            queue.push({score, top.second});
+            continue;
+        }
+
+        const Segment& seg = segments[top.second];
+        for (size_t i = 0; i + KMER_LEN <= seg.size; ++i) {
+            kmers[kmerKey(seg.data + i)].covered = true;
+        }
+        chosen.push_back(top.second);
+        contentSize += seg.size;
+    }
+
+    // Лучшие сегменты — в конец, ближе всего к данным записи
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        const Segment& seg = segments[*it];
+        size_t take = min(seg.size, maxContentSize - dict.content.size());
+        dict.content.insert(dict.content.end(), seg.data + seg.size - take, seg.data + seg.size);
+        if (dict.content.size() == maxContentSize) break;
+    }
+
+    dict.id = dictionaryId(dict);
+    dict.huffman = buildHuffmanTable(dict.frequencies);
+    return dict;
+}
+
+static void writeU32(ostream& out, uint32_t v) {
+    uint8_t bytes[4] = {
+        static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8),
+        static_cast<uint8_t>(v >> 16), static_cast<uint8_t>(v >> 24)
+    };
+    out.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static uint32_t readU32(istream& in) {
+    uint8_t bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4)) {
+        throw runtime_error("truncated dictionary file");
+    }
+    return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) |
+           (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+void saveDictionary(const Dictionary& dict, ostream& out) {
+    out.write(reinterpret_cast<const char*>(DICT_MAGIC), 4);
+    writeU32(out, dict.id);
+    writeU32(out, static_cast<uint32_t>(dict.content.size()));
+    out.write(reinterpret_cast<const char*>(dict.content.data()), dict.content.size());
+    for (uint32_t f : dict.frequencies) writeU32(out, f);
+    if (!out) throw runtime_error("failed to write dictionary");
+}
+
+Dictionary loadDictionary(istream& in) {
+    uint8_t magic[4];
+    if (!in.read(reinterpret_cast<char*>(magic), 4) || !equal(DICT_MAGIC, DICT_MAGIC + 4, magic)) {
+        throw runtime_error("not a dictionary file");
+    }
+
+    Dictionary dict;
+    dict.id = readU32(in);
+    uint32_t contentSize = readU32(in);
+    if (contentSize > (1u << 24)) throw runtime_error("corrupt dictionary file");
+    dict.content.resize(contentSize);
+    if (!in.read(reinterpret_cast<char*>(dict.content.data()), contentSize)) {
+        throw runtime_error("truncated dictionary file");
+    }
+    for (uint32_t& f : dict.frequencies) f = readU32(in);
+
+    if (dictionaryId(dict) != dict.id) throw runtime_error("dictionary checksum mismatch");
+    dict.huffman = buildHuffmanTable(dict.frequencies);
+    return dict;
+}
@@ -0,0 +1,30 @@
+// dict.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "../huffman/huffman.h"
+
+// Обученный словарь для маленьких записей: префикс окна LZ77 и
+// статическая таблица Хаффмана. На словарь ссылаются по id, который
+// записывается в заголовок контейнера.
+struct Dictionary {
+    uint32_t id = 0;
+    std::vector<uint8_t> content;      // Префикс LZ77, не длиннее LZ77_WINDOW_SIZE
+    uint32_t frequencies[256] = {};    // Частоты для статической таблицы
+    std::shared_ptr<const HuffmanTable> huffman; // Строится один раз при загрузке
+};
+
+// Обучение по набору образцов. maxContentSize ограничивает префикс LZ77
+Dictionary trainDictionary(const std::vector<std::vector<uint8_t>>& samples,
+                           size_t maxContentSize);
+
+// Файл словаря: "CFZD", id, размер префикса, префикс, 256 частот.
+// Ошибки формата — std::runtime_error.
+void saveDictionary(const Dictionary& dict, std::ostream& out);
+Dictionary loadDictionary(std::istream& in);
@@ -6,73 +6,89 @@
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <algorithm>
+
+#include "huffman.h"
+#include "../dict/dict.h"
+#include "../stats/stats.h"
 
 using namespace std;
 
-// Узел дерева Хаффмана с shared_ptr для удобства управления памятью
+// Узел дерева Хаффмана; дети — индексы в том же массиве (-1 у листа)
 struct Node {
     uint8_t ch;
-    int freq;
-    shared_ptr<Node> left;
-    shared_ptr<Node> right;
-
-    // Конструктор для листового узла
-    Node(uint8_t c, int f) : ch(c), freq(f), left(nullptr), right(nullptr) {}
-    // Конструктор для внутреннего узла
-    Node(int f, shared_ptr<Node> l, shared_ptr<Node> r)
-        : ch(0), freq(f), left(move(l)), right(move(r)) {}
+    uint64_t freq; // Сумма частот листьев: больше любой 32-битной частоты
+    int left;
+    int right;
 };
 
-// Компаратор для очереди с shared_ptr
-struct Compare {
-    bool operator()(const shared_ptr<Node>& a, const shared_ptr<Node>& b) {
-        return a->freq > b->freq;
-    }
-};
+// Дерево целиком в одном массиве (не больше 511 узлов): одно выделение
+// памяти вместо shared_ptr на каждый узел. Индекс узла — порядок его
+// создания, он разрешает равенство частот одинаково у кодера и декодера.
+struct HuffmanTree {
+    vector<Node> nodes;
+    int root = -1;
 
-// Построение дерева Хаффмана с использованием shared_ptr
-shared_ptr<Node> buildTree(const unordered_map<uint8_t, int>& freqMap) {
-    priority_queue<shared_ptr<Node>, vector<shared_ptr<Node>>, Compare> pq;
+    bool isLeaf(int i) const { return nodes[i].left < 0; }
+};
 
-    // Создаём листовые узлы
-    for (const auto& p : freqMap) {
-        pq.push(make_shared<Node>(p.first, p.second));
+// Построение дерева Хаффмана
+static void buildTree(const unordered_map<uint8_t, uint32_t>& freqMap, HuffmanTree& tree) {
+    vector<Node>& nodes = tree.nodes;
+    nodes.clear();
+    nodes.reserve(freqMap.size() * 2);
+    tree.root = -1;
+
+    auto later = [&nodes](int a, int b) {
+        if (nodes[a].freq != nodes[b].freq) return nodes[a].freq > nodes[b].freq;
+        return a > b;
+    };
+    priority_queue<int, vector<int>, decltype(later)> pq(later);
+
+    // Создаём листовые узлы в порядке символов: порядок обхода
+    // unordered_map у кодера и декодера может различаться
+    vector<pair<uint8_t, uint32_t>> leaves(freqMap.begin(), freqMap.end());
+    sort(leaves.begin(), leaves.end());
+
+    for (const auto& p : leaves) {
+        nodes.push_back({p.first, p.second, -1, -1});
+        pq.push(static_cast<int>(nodes.size() - 1));
     }
 
     // Строим дерево
     while (pq.size() > 1) {
-        auto left = pq.top(); pq.pop();
-        auto right = pq.top(); pq.pop();
+        int left = pq.top(); pq.pop();
+        int right = pq.top(); pq.pop();
 
-        int sumFreq = left->freq + right->freq;
-        pq.push(make_shared<Node>(sumFreq, left, right));
+        nodes.push_back({0, nodes[left].freq + nodes[right].freq, left, right});
+        pq.push(static_cast<int>(nodes.size() - 1));
     }
 
-    if (pq.empty()) return nullptr;
-    return pq.top();
+    if (!pq.empty()) tree.root = pq.top();
 }
 
 // Рекурсивная генерация кодов Хаффмана
-void generateCodes(const Node* node, const string& code, unordered_map<uint8_t, string>& codes) {
-    if (!node) return;
+static void generateCodes(const HuffmanTree& tree, int node, const string& code,
+                          unordered_map<uint8_t, string>& codes) {
+    if (node < 0) return;
 
-    if (!node->left && !node->right) {
-        codes[node->ch] = code;
+    if (tree.isLeaf(node)) {
+        codes[tree.nodes[node].ch] = code;
         return;
     }
 
-    generateCodes(node->left.get(), code + "0", codes);
-    generateCodes(node->right.get(), code + "1", codes);
+    generateCodes(tree, tree.nodes[node].left, code + "0", codes);
+    generateCodes(tree, tree.nodes[node].right, code + "1", codes);
 }
 
-// Класс для записи битов в поток
+// Класс для записи битов в буфер
 class BitWriter {
-    ostream& out_;
+    vector<uint8_t>& out_;
     uint8_t buffer_ = 0;
     int bitPos_ = 0;
 
 public:
-    BitWriter(ostream& out) : out_(out) {}
+    BitWriter(vector<uint8_t>& out) : out_(out) {}
 
     ~BitWriter() {
         flush();
@@ -85,7 +101,7 @@ public:
         ++bitPos_;
 
         if (bitPos_ == 8) {
-            out_.put(buffer_);
+            out_.push_back(buffer_);
             buffer_ = 0;
             bitPos_ = 0;
         }
@@ -99,27 +115,27 @@ public:
 
     void flush() {
         if (bitPos_ > 0) {
-            out_.put(buffer_);
+            out_.push_back(buffer_);
             buffer_ = 0;
             bitPos_ = 0;
         }
     }
 };
 
-// Класс для чтения битов из потока
+// Класс для чтения битов из буфера
 class BitReader {
-    istream& in_;
+    const uint8_t* pos_;
+    const uint8_t* end_;
     uint8_t buffer_ = 0;
     int bitPos_ = 8;
 
 public:
-    BitReader(istream& in) : in_(in) {}
+    BitReader(const uint8_t* data, size_t size) : pos_(data), end_(data + size) {}
 
     bool readBit(bool& bit) {
         if (bitPos_ == 8) {
-            int byte = in_.get();
-            if (byte == EOF) return false;
-            buffer_ = static_cast<uint8_t>(byte);
+            if (pos_ == end_) return false;
+            buffer_ = *pos_++;
             bitPos_ = 0;
         }
 
@@ -129,143 +145,624 @@ public:
     }
 };
 
-// Функция сжатия файла
-void encodeFile(const string& inputFile, const string& outputFile) {
-    ifstream in(inputFile, ios::binary);
-    if (!in) {
-        cerr << "Cannot open input file\n";
-        return;
+template <typename T>
+static void appendValue(vector<uint8_t>& out, T value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+template <typename T>
+static bool readValue(const uint8_t*& pos, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - pos) < sizeof(value)) return false;
+    copy(pos, pos + sizeof(value), reinterpret_cast<uint8_t*>(&value));
+    pos += sizeof(value);
+    return true;
+}
+
+// Гистограмма байтов: четыре независимых счётчика, чтобы соседние
+// одинаковые байты не упирались в одну и ту же ячейку
+void buildHistogram(const uint8_t* data, size_t size, uint32_t* counts) {
+    uint32_t partial[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        partial[0][data[i]]++;
+        partial[1][data[i + 1]]++;
+        partial[2][data[i + 2]]++;
+        partial[3][data[i + 3]]++;
     }
+    for (; i < size; ++i) partial[0][data[i]]++;
+    for (int c = 0; c < 256; ++c) {
+        counts[c] = partial[0][c] + partial[1][c] + partial[2][c] + partial[3][c];
+    }
+}
 
-    vector<uint8_t> data((istreambuf_iterator<char>(in)), {});
-    in.close();
+// Статическая таблица: дерево и коды строятся один раз на словарь
+struct HuffmanTable {
+    HuffmanTree tree;
+    unordered_map<uint8_t, string> codes;
+};
 
-    if (data.size() < 32) {
-        ofstream out(outputFile, ios::binary);
-        out.put('U'); // Маркер несжатого файла
-        out.write(reinterpret_cast<const char*>(data.data()), data.size());
-        return;
+shared_ptr<const HuffmanTable> buildHuffmanTable(const uint32_t* frequencies) {
+    unordered_map<uint8_t, uint32_t> freqMap;
+    for (int c = 0; c < 256; ++c) {
+        if (frequencies[c] > 0) freqMap[static_cast<uint8_t>(c)] = frequencies[c];
     }
 
-    unordered_map<uint8_t, int> freqMap;
-    for (uint8_t c : data) freqMap[c]++;
+    auto table = make_shared<HuffmanTable>();
+    buildTree(freqMap, table->tree);
+    generateCodes(table->tree, table->tree.root, "", table->codes);
+    return table;
+}
 
-    auto root = buildTree(freqMap);
-    unordered_map<uint8_t, string> codes;
-    generateCodes(root.get(), "", codes);
+// Кодирование символов готовыми кодами; false — символа нет в таблице
+static bool encodeSymbols(const uint8_t* data, size_t size, const unordered_map<uint8_t, string>& codes,
+                          vector<uint8_t>& out, HuffmanStats& stats) {
+    StageTimer t(stats.encodeMs);
+    BitWriter writer(out);
+    for (size_t i = 0; i < size; ++i) {
+        auto it = codes.find(data[i]);
+        if (it == codes.end()) return false;
+        writer.writeBits(it->second);
+        stats.bits += it->second.size();
+    }
+    return true;
+}
 
-    ofstream out(outputFile, ios::binary);
-    out.put('C'); // Маркер сжатого файла
-    uint32_t dataSize = data.size();
-    out.write(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
-    uint16_t uniqueCount = freqMap.size();
-    out.write(reinterpret_cast<const char*>(&uniqueCount), sizeof(uniqueCount));
+// Декодирование dataSize символов обходом дерева
+static bool decodeSymbols(const HuffmanTree& tree, const uint8_t* pos, const uint8_t* end,
+                          uint32_t dataSize, vector<uint8_t>& out) {
+    const int root = tree.root;
+    // Обработка случая дерева из одного узла
+    if (tree.isLeaf(root)) {
+        out.insert(out.end(), dataSize, tree.nodes[root].ch);
+        return true;
+    }
 
-    for (const auto& p : freqMap) {
-        out.put(p.first);
-        uint32_t freq = p.second;
-        out.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
+    HuffmanStats stats;
+    BitReader reader(pos, end - pos);
+    int node = root;
+    uint32_t written = 0;
+    bool bit;
+
+    out.reserve(out.size() + dataSize);
+    {
+        StageTimer t(stats.decodeMs);
+        while (written < dataSize) {
+            if (!reader.readBit(bit)) {
+                cerr << "Unexpected end of file\n";
+                break;
+            }
+            ++stats.bits;
+
+            // Во внутреннем узле оба ребёнка есть всегда
+            node = bit ? tree.nodes[node].right : tree.nodes[node].left;
+
+            if (tree.isLeaf(node)) {
+                out.push_back(tree.nodes[node].ch);
+                node = root;
+                ++written;
+            }
+        }
     }
 
-    BitWriter writer(out);
-    for (uint8_t c : data) {
-        writer.writeBits(codes[c]);
+    stats.symbols = written;
+    recordStats(stats);
+
+    if (written != dataSize) {
+        cerr << "Size mismatch: expected " << dataSize << ", decoded " << written << "\n";
+        return false;
     }
+    return true;
 }
 
-// Функция распаковки файла
-void decodeFile(const string& inputFile, const string& outputFile) {
-    ifstream in(inputFile, ios::binary);
-    if (!in) {
-        cerr << "Cannot open input file\n";
+// Сжатие статической таблицей: без заголовка частот, поэтому выгодно
+// и для маленьких записей
+static void compressStatic(const uint8_t* data, size_t size, const HuffmanTable& table,
+                           vector<uint8_t>& out) {
+    const size_t start = out.size();
+    HuffmanStats stats;
+
+    out.push_back('S'); // Маркер блока со статической таблицей
+    appendValue(out, static_cast<uint32_t>(size));
+    bool encoded = encodeSymbols(data, size, table.codes, out, stats);
+
+    // Данные не похожи на обучающую выборку — храним как есть
+    if (!encoded || out.size() - start > size + 1) {
+        out.resize(start);
+        out.push_back('U');
+        out.insert(out.end(), data, data + size);
         return;
     }
 
-    char marker;
-    in.get(marker);
+    stats.symbols = size;
+    recordStats(stats);
+}
 
-    if (marker == 'U') {
-        // Несжатый файл — просто копируем
-        ofstream out(outputFile);
-        char c;
-        while (in.get(c)) out.put(c);
+// Сжатие блока в памяти
+void huffmanCompress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                     const HuffmanTable* table, HuffmanContext* context) {
+    if (table) {
+        compressStatic(data, size, *table, out);
+        return;
+    }
+
+    if (size < 32) {
+        out.push_back('U'); // Маркер несжатого блока
+        out.insert(out.end(), data, data + size);
         return;
     }
 
+    HuffmanContext local;
+    HuffmanContext& ctx = context ? *context : local;
+
+    HuffmanStats stats;
+    // Коды не очищаются: строки прошлых блоков переиспользуются, а лишние
+    // символы в этом блоке не встречаются
+    unordered_map<uint8_t, uint32_t>& freqMap = ctx.freqMap;
+    unordered_map<uint8_t, string>& codes = ctx.codes;
+    freqMap.clear();
+    {
+        StageTimer t(stats.histogramMs);
+        uint32_t counts[256];
+        buildHistogram(data, size, counts);
+        for (int c = 0; c < 256; ++c) {
+            if (counts[c] > 0) freqMap[static_cast<uint8_t>(c)] = counts[c];
+        }
+    }
+
+    HuffmanTree tree;
+    {
+        StageTimer t(stats.treeMs);
+        buildTree(freqMap, tree);
+        generateCodes(tree, tree.root, "", codes);
+    }
+
+    out.push_back('C'); // Маркер сжатого блока
+    appendValue(out, static_cast<uint32_t>(size));
+    appendValue(out, static_cast<uint16_t>(freqMap.size()));
+
+    for (const auto& p : freqMap) {
+        out.push_back(p.first);
+        appendValue(out, p.second);
+    }
+
+    encodeSymbols(data, size, codes, out, stats);
+
+    stats.symbols = size;
+    recordStats(stats);
+}
+
+// Размер из заголовка блока против ожидаемого: exact — ровно rawSize,
+// иначе не больше rawSize (вложенный поток другого кодека)
+static bool blockSizeAllowed(size_t dataSize, size_t rawSize, bool exact) {
+    if (rawSize == CODEC_UNKNOWN_SIZE) return true;
+    if (exact ? dataSize == rawSize : dataSize <= rawSize) return true;
+    cerr << "Block size " << dataSize << " does not match the expected " << rawSize << "\n";
+    return false;
+}
+
+// Распаковка блока в памяти, результат дописывается в out
+static bool decompressBlock(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                            const HuffmanTable* table, size_t rawSize, bool exact) {
+    const uint8_t* pos = data;
+    const uint8_t* end = data + size;
+
+    if (pos == end) {
+        cerr << "Invalid file format\n";
+        return false;
+    }
+    uint8_t marker = *pos++;
+
+    if (marker == 'U') {
+        // Несжатый блок — просто копируем
+        if (!blockSizeAllowed(end - pos, rawSize, exact)) return false;
+        out.insert(out.end(), pos, end);
+        return true;
+    }
+
+    if (marker == 'S') {
+        if (!table) {
+            cerr << "Static Huffman table required\n";
+            return false;
+        }
+        uint32_t dataSize;
+        if (!readValue(pos, end, dataSize)) {
+            cerr << "Failed to read data size\n";
+            return false;
+        }
+        if (!blockSizeAllowed(dataSize, rawSize, exact)) return false;
+        return decodeSymbols(table->tree, pos, end, dataSize, out);
+    }
+
     if (marker != 'C') {
         cerr << "Invalid file format\n";
-        return;
+        return false;
     }
 
     uint32_t dataSize;
-    if (!in.read(reinterpret_cast<char*>(&dataSize), sizeof(dataSize))) {
+    if (!readValue(pos, end, dataSize)) {
         cerr << "Failed to read data size\n";
-        return;
+        return false;
     }
+    if (!blockSizeAllowed(dataSize, rawSize, exact)) return false;
 
     uint16_t uniqueCount;
-    if (!in.read(reinterpret_cast<char*>(&uniqueCount), sizeof(uniqueCount))) {
+    if (!readValue(pos, end, uniqueCount)) {
         cerr << "Failed to read unique count\n";
-        return;
+        return false;
     }
 
-    unordered_map<uint8_t, int> freqMap;
+    // Частоты — счётчики символов блока: их сумма не больше dataSize
+    unordered_map<uint8_t, uint32_t> freqMap;
+    uint64_t total = 0;
     for (int i = 0; i < uniqueCount; ++i) {
-        uint8_t c = in.get();
-        if (in.eof()) {
-            cerr << "Unexpected end of file\n";
-            return;
-        }
+        uint8_t c;
         uint32_t freq;
-        if (!in.read(reinterpret_cast<char*>(&freq), sizeof(freq))) {
+        if (!readValue(pos, end, c) || !readValue(pos, end, freq)) {
             cerr << "Failed to read frequency\n";
-            return;
+            return false;
+        }
+        total += freq;
+        if (total > dataSize) {
+            cerr << "Symbol frequencies exceed block size\n";
+            return false;
         }
         freqMap[c] = freq;
     }
 
-    auto root = buildTree(freqMap);
-    if (!root) {
+    HuffmanTree tree;
+    buildTree(freqMap, tree);
+    if (tree.root < 0) {
         cerr << "Failed to build Huffman tree\n";
-        return;
+        return false;
     }
 
-    // Открываем файл в текстовом режиме для записи символов
-    ofstream out(outputFile);
+    return decodeSymbols(tree, pos, end, dataSize, out);
+}
 
-    // Обработка случая дерева из одного узла
-    if (!root->left && !root->right) {
-        for (uint32_t i = 0; i < dataSize; ++i) {
-            out.put(static_cast<char>(root->ch));
+bool huffmanDecompress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                       const HuffmanTable* table, size_t rawSize) {
+    return decompressBlock(data, size, out, table, rawSize, true);
+}
+
+bool huffmanDecompressBounded(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                              size_t maxSize) {
+    return decompressBlock(data, size, out, nullptr, maxSize, false);
+}
+
+// Потоковый формат: 'A', сегменты, завершающий 'E'. Сегмент:
+//   'N' u32 символов, u16 число символов таблицы, (u8 символ, u16 частота-1)...,
+//       u32 байт кода, код новой таблицей
+//   'R' u32 символов, u32 байт кода, код прежней таблицей
+//   'U' u32 символов, байты как есть
+static const uint8_t STREAM_MARKER = 'A';
+static const uint8_t SEGMENT_NEW = 'N';
+static const uint8_t SEGMENT_REUSE = 'R';
+static const uint8_t SEGMENT_RAW = 'U';
+static const uint8_t SEGMENT_END = 'E';
+
+// Частота в сегменте не больше его длины и пишется как u16 (частота-1)
+static_assert(HUFFMAN_SEGMENT_SIZE <= 65536, "segment frequencies must fit in 16 bits");
+
+// Таблица потокового режима и длины её кодов для оценки выигрыша
+struct AdaptiveTable {
+    HuffmanTree tree;
+    unordered_map<uint8_t, string> codes;
+    int lengths[256]; // -1 — символа нет в таблице
+};
+
+static void buildAdaptiveTable(const uint32_t* counts, AdaptiveTable& table) {
+    unordered_map<uint8_t, uint32_t> freqMap;
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] > 0) freqMap[static_cast<uint8_t>(c)] = counts[c];
+    }
+    buildTree(freqMap, table.tree);
+    table.codes.clear();
+    generateCodes(table.tree, table.tree.root, "", table.codes);
+    fill(table.lengths, table.lengths + 256, -1);
+    for (const auto& p : table.codes) table.lengths[p.first] = static_cast<int>(p.second.size());
+}
+
+// Биты кода сегмента с гистограммой counts; UINT64_MAX — в таблице нет символа
+static uint64_t payloadBits(const AdaptiveTable& table, const uint32_t* counts) {
+    uint64_t bits = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] == 0) continue;
+        if (table.lengths[c] < 0) return UINT64_MAX;
+        bits += uint64_t(counts[c]) * table.lengths[c];
+    }
+    return bits;
+}
+
+static bool readStreamBytes(istream& in, uint8_t* data, size_t size, IOStats& io) {
+    StageTimer t(io.readMs);
+    in.read(reinterpret_cast<char*>(data), size);
+    size_t got = static_cast<size_t>(in.gcount());
+    io.bytesRead += got;
+    return got == size;
+}
+
+template <typename T>
+static bool readStreamValue(istream& in, T& value, IOStats& io) {
+    return readStreamBytes(in, reinterpret_cast<uint8_t*>(&value), sizeof(value), io);
+}
+
+// Пишет сегмент и сразу сбрасывает поток: по каналу он уходит, не
+// дожидаясь заполнения буфера ostream
+static bool writeStreamBytes(ostream& out, const vector<uint8_t>& data, IOStats& io) {
+    StageTimer t(io.writeMs);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.flush();
+    io.bytesWritten += data.size();
+    return static_cast<bool>(out);
+}
+
+// Сегмент из того, что уже пришло: ждёт только первый байт, остальное
+// добирает без блокировки (readsome), пока сегмент не заполнится.
+// Файл отдаёт полные сегменты, медленный канал — короткие, зато сразу.
+// 0 — конец входа
+static size_t readSegment(istream& in, vector<uint8_t>& segment, IOStats& io) {
+    StageTimer t(io.readMs);
+    char* data = reinterpret_cast<char*>(segment.data());
+    in.read(data, 1);
+    size_t size = static_cast<size_t>(in.gcount());
+    while (size > 0 && size < segment.size()) {
+        streamsize got = in.readsome(data + size, segment.size() - size);
+        if (got <= 0) break;
+        size += static_cast<size_t>(got);
+    }
+    io.bytesRead += size;
+    return size;
+}
+
+// Однопроходное сжатие: в памяти только текущий сегмент и его код
+bool huffmanEncodeStream(istream& in, ostream& out) {
+    IOStats io;
+    HuffmanStats stats;
+    vector<uint8_t> segment(HUFFMAN_SEGMENT_SIZE);
+    vector<uint8_t> record(1, STREAM_MARKER);
+    AdaptiveTable current, candidate;
+    bool hasTable = false;
+
+    while (true) {
+        size_t size = readSegment(in, segment, io);
+        if (in.bad()) {
+            cerr << "Read error\n";
+            return false;
         }
-        return;
+        if (size == 0) break;
+
+        uint32_t counts[256];
+        {
+            StageTimer t(stats.histogramMs);
+            buildHistogram(segment.data(), size, counts);
+        }
+        {
+            StageTimer t(stats.treeMs);
+            buildAdaptiveTable(counts, candidate);
+        }
+
+        // Новая таблица окупается, только если код короче на её заголовок
+        uint64_t reuseBits = hasTable ? payloadBits(current, counts) : UINT64_MAX;
+        uint64_t newBits = payloadBits(candidate, counts) + 8 * (2 + 3 * candidate.codes.size());
+        uint64_t rawBits = 8 * uint64_t(size);
+
+        uint8_t kind = SEGMENT_RAW;
+        if (reuseBits <= newBits && reuseBits < rawBits) {
+            kind = SEGMENT_REUSE;
+        } else if (newBits < rawBits) {
+            kind = SEGMENT_NEW;
+            swap(current, candidate);
+            hasTable = true;
+        }
+
+        record.push_back(kind);
+        appendValue(record, static_cast<uint32_t>(size));
+        if (kind == SEGMENT_RAW) {
+            record.insert(record.end(), segment.begin(), segment.begin() + size);
+        } else {
+            if (kind == SEGMENT_NEW) {
+                appendValue(record, static_cast<uint16_t>(current.codes.size()));
+                for (int c = 0; c < 256; ++c) {
+                    if (counts[c] == 0) continue;
+                    record.push_back(static_cast<uint8_t>(c));
+                    appendValue(record, static_cast<uint16_t>(counts[c] - 1));
+                }
+                ++stats.tables;
+            }
+            size_t sizeAt = record.size();
+            appendValue(record, uint32_t(0));
+            encodeSymbols(segment.data(), size, current.codes, record, stats);
+            uint32_t payloadSize = static_cast<uint32_t>(record.size() - sizeAt - 4);
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&payloadSize);
+            copy(p, p + 4, record.begin() + sizeAt);
+            stats.symbols += size;
+        }
+        ++stats.segments;
+
+        if (!writeStreamBytes(out, record, io)) {
+            cerr << "Write error\n";
+            return false;
+        }
+        record.clear();
     }
 
-    BitReader reader(in);
-    const Node* node = root.get();
-    uint32_t written = 0;
-    bool bit;
+    record.push_back(SEGMENT_END);
+    if (!writeStreamBytes(out, record, io)) {
+        cerr << "Write error\n";
+        return false;
+    }
+    recordStats(stats);
+    recordStats(io);
+    return true;
+}
+
+bool huffmanDecodeStream(istream& in, ostream& out) {
+    IOStats io;
+    uint8_t marker;
+    if (!readStreamValue(in, marker, io) || marker != STREAM_MARKER) {
+        cerr << "Invalid file format\n";
+        return false;
+    }
 
-    while (written < dataSize) {
-        if (!reader.readBit(bit)) {
+    HuffmanTree tree;
+    vector<uint8_t> payload, data;
+    while (true) {
+        uint8_t kind;
+        uint32_t symbols;
+        if (!readStreamValue(in, kind, io)) {
+            cerr << "Unexpected end of file\n";
+            return false;
+        }
+        if (kind == SEGMENT_END) break;
+        if (!readStreamValue(in, symbols, io)) {
             cerr << "Unexpected end of file\n";
-            break;
+            return false;
+        }
+        if (symbols == 0 || symbols > HUFFMAN_SEGMENT_SIZE) {
+            cerr << "Invalid segment size\n";
+            return false;
         }
 
-        node = bit ? node->right.get() : node->left.get();
-        if (!node) {
-            cerr << "Invalid bit sequence\n";
-            break;
+        data.clear();
+        if (kind == SEGMENT_RAW) {
+            data.resize(symbols);
+            if (!readStreamBytes(in, data.data(), symbols, io)) {
+                cerr << "Unexpected end of file\n";
+                return false;
+            }
+        } else if (kind == SEGMENT_NEW || kind == SEGMENT_REUSE) {
+            if (kind == SEGMENT_NEW) {
+                uint16_t count;
+                if (!readStreamValue(in, count, io) || count == 0 || count > 256) {
+                    cerr << "Failed to read table\n";
+                    return false;
+                }
+                unordered_map<uint8_t, uint32_t> freqMap;
+                for (int i = 0; i < count; ++i) {
+                    uint8_t c;
+                    uint16_t freq;
+                    if (!readStreamValue(in, c, io) || !readStreamValue(in, freq, io)) {
+                        cerr << "Failed to read frequency\n";
+                        return false;
+                    }
+                    freqMap[c] = freq + 1;
+                }
+                buildTree(freqMap, tree);
+            } else if (tree.root < 0) {
+                cerr << "Segment refers to a missing table\n";
+                return false;
+            }
+
+            // Кодер выбирает код, только если он короче самих байт
+            uint32_t payloadSize;
+            if (!readStreamValue(in, payloadSize, io) || payloadSize > symbols) {
+                cerr << "Invalid segment payload\n";
+                return false;
+            }
+            payload.resize(payloadSize);
+            if (!readStreamBytes(in, payload.data(), payloadSize, io)) {
+                cerr << "Unexpected end of file\n";
+                return false;
+            }
+            if (!decodeSymbols(tree, payload.data(), payload.data() + payloadSize, symbols, data)) {
+                return false;
+            }
+        } else {
+            cerr << "Invalid segment type\n";
+            return false;
         }
 
-        if (!node->left && !node->right) {
-            out.put(static_cast<char>(node->ch));
-            node = root.get();
-            ++written;
+        if (!writeStreamBytes(out, data, io)) {
+            cerr << "Write error\n";
+            return false;
         }
     }
 
-    if (written != dataSize) {
-        cerr << "Size mismatch: expected " << dataSize << ", decoded " << written << "\n";
+    recordStats(io);
+    return true;
+}
+
+// Функция сжатия файла: потоковый формат, без чтения файла целиком
+void encodeFile(const string& inputFile, const string& outputFile) {
+    ifstream in(inputFile, ios::binary);
+    if (!in) {
+        cerr << "Cannot open input file\n";
+        return;
+    }
+    ofstream out(outputFile, ios::binary);
+    if (!out) {
+        cerr << "Cannot create output file\n";
+        return;
     }
+    huffmanEncodeStream(in, out);
 }
+
+// Функция распаковки файла
+void decodeFile(const string& inputFile, const string& outputFile) {
+    ifstream in(inputFile, ios::binary);
+    if (!in) {
+        cerr << "Cannot open input file\n";
+        return;
+    }
+
+    if (in.peek() == STREAM_MARKER) {
+        ofstream out(outputFile, ios::binary);
+        if (!out) {
+            cerr << "Cannot create output file\n";
+            return;
+        }
+        huffmanDecodeStream(in, out);
+        return;
+    }
+
+    // Прежний формат: файл целиком одним блоком
+    IOStats io;
+    vector<uint8_t> packed;
+    {
+        StageTimer t(io.readMs);
+        packed.assign(istreambuf_iterator<char>(in), {});
+    }
+    io.bytesRead = packed.size();
+
+    vector<uint8_t> data;
+    huffmanDecompress(packed.data(), packed.size(), data);
+
+    ofstream out(outputFile, ios::binary);
+    {
+        StageTimer t(io.writeMs);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    io.bytesWritten = data.size();
+    recordStats(io);
+}
+
+// Со словарём блоки кодируются его статической таблицей
+class HuffmanCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::Huffman; }
+    const char* name() const override { return "Huffman"; }
+
+    void compress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                  const CodecParams& params, CodecContext* context) const override {
+        huffmanCompress(data, size, out,
+                        params.dictionary ? params.dictionary->huffman.get() : nullptr,
+                        context ? &context->scratch<HuffmanContext>(id()) : nullptr);
+    }
+
+    bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize,
+                    const CodecParams& params) const override {
+        return huffmanDecompress(data, size, out,
+                                 params.dictionary ? params.dictionary->huffman.get() : nullptr,
+                                 rawSize);
+    }
+
+    // Результат и его рост при записи битов, плюс дерево и коды
+    size_t workingMemory(size_t blockSize) const override {
+        return 2 * blockSize + (size_t(64) << 10);
+    }
+
+    bool usesDictionary() const override { return true; }
+};
+
+static CodecRegistration<HuffmanCodec> registerHuffman;
@@ -0,0 +1,60 @@
+// huffman.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../codec/codec.h"
+
+// Гистограмма байтов блока (256 счётчиков); общая для энтропийных кодеков
+void buildHistogram(const uint8_t* data, size_t size, uint32_t* counts);
+
+// Готовое дерево и коды для статического кодирования
+struct HuffmanTable;
+
+// Строит таблицу по 256 частотам; нулевые частоты — символ не кодируется
+std::shared_ptr<const HuffmanTable> buildHuffmanTable(const uint32_t* frequencies);
+
+// Гистограмма и коды, переиспользуемые между блоками одного потока
+struct HuffmanContext : CodecScratch {
+    std::unordered_map<uint8_t, uint32_t> freqMap;
+    std::unordered_map<uint8_t, std::string> codes;
+};
+
+// Сжатие блока в памяти; формат совпадает с файлом encodeFile.
+// Со статической таблицей заголовок частот не пишется (маркер 'S').
+// Результат дописывается в конец out.
+void huffmanCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                     const HuffmanTable* table = nullptr, HuffmanContext* context = nullptr);
+// Распаковка блока; false — повреждённые данные или нет нужной таблицы.
+// rawSize — ожидаемый размер: блок с другим размером в заголовке
+// отвергается до декодирования
+bool huffmanDecompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                       const HuffmanTable* table = nullptr,
+                       size_t rawSize = CODEC_UNKNOWN_SIZE);
+// То же для вложенного потока, точный размер которого не известен:
+// отвергается блок длиннее maxSize
+bool huffmanDecompressBounded(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                              size_t maxSize);
+
+// Потоковый адаптивный режим без контейнера: вход кодируется сегментами
+// не длиннее HUFFMAN_SEGMENT_SIZE байт из того, что уже пришло, и каждый
+// сегмент сразу сбрасывается в out. Таблица строится по
+// самому сегменту и записывается, только если выигрыш от неё больше
+// её заголовка; иначе сегмент кодируется прежней таблицей.
+const size_t HUFFMAN_SEGMENT_SIZE = size_t(64) << 10;
+
+// false — ошибка чтения или записи (сообщение в stderr)
+bool huffmanEncodeStream(std::istream& in, std::ostream& out);
+// false — повреждённые данные или ошибка ввода-вывода (сообщение в stderr)
+bool huffmanDecodeStream(std::istream& in, std::ostream& out);
+
+// Файл в потоковом формате; decodeFile читает и прежний формат целого файла
+void encodeFile(const std::string& inputFile, const std::string& outputFile);
+void decodeFile(const std::string& inputFile, const std::string& outputFile);
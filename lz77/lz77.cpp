@@ -2,23 +2,321 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <deque>
 #include <string>
 #include <algorithm>
 #include <cstdint>
+#include <climits>
+
+#include "lz77.h"
+#include "../dict/dict.h"
+#include "../stats/stats.h"
 
 using namespace std;
 
-const size_t WINDOW_SIZE = 4096;    // Размер окна
-const size_t MAX_MATCH_LEN = 18;    // Максимальная длина совпадения
-const size_t MIN_MATCH_LEN = 3;     // Минимальная длина совпадения
+const size_t MIN_HASH_BITS = 10;    // Размер таблицы голов хеш-цепочек
+const size_t TOKEN_SIZE = 6;        // offset(2) + length(2) + nextChar(1) + выравнивание(1)
+
+// Глубина просмотра хеш-цепочки для уровней 1..8; 9 — полный перебор окна
+static const size_t CHAIN_DEPTH[LZ77_MAX_LEVEL] = {
+    0, 4, 8, 16, 32, 64, 128, 512, 1024
+};
 
 struct Token {
-    uint16_t offset;
+    uint16_t offset;    // Расстояние до начала совпадения минус 1
     uint16_t length;
-    uint8_t nextChar;
+    uint8_t nextChar;   // Всегда присутствует: совпадение не доходит до конца блока
+};
+
+static void appendToken(vector<uint8_t>& out, const Token& token) {
+    uint8_t bytes[TOKEN_SIZE] = {
+        static_cast<uint8_t>(token.offset), static_cast<uint8_t>(token.offset >> 8),
+        static_cast<uint8_t>(token.length), static_cast<uint8_t>(token.length >> 8),
+        token.nextChar, 0
+    };
+    out.insert(out.end(), bytes, bytes + TOKEN_SIZE);
+}
+
+static inline uint32_t hash3(const uint8_t* p, size_t hashBits) {
+    uint32_t v = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+    return (v * 2654435761u) >> (32 - hashBits);
+}
+
+static inline uint32_t hash4(const uint8_t* p, size_t hashBits) {
+    uint32_t v = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+                 (uint32_t(p[3]) << 24);
+    return (v * 2654435761u) >> (32 - hashBits);
+}
+
+// Ядро LZ77 с параметрами окна и длин совпадений, известными при
+// компиляции: маски окна, границы циклов сравнения и выбор хеша
+// сворачиваются в константы. Формат токенов у всех пресетов общий.
+template <size_t WindowSize, size_t MinMatch, size_t MaxMatch>
+struct LZ77Kernel {
+    static_assert((WindowSize & (WindowSize - 1)) == 0 && WindowSize <= 65536,
+                  "window is a power of two addressable by a 16-bit offset");
+    static_assert(MinMatch == 3 || MinMatch == 4, "hash covers 3 or 4 bytes");
+    static_assert(MaxMatch >= MinMatch && MaxMatch <= 65535, "length fits the token");
+
+    static constexpr size_t MAX_HASH_BITS = WindowSize >= 65536 ? 16 : 15;
+
+    // Результат не длиннее блока, окно со словарём и хеш-цепочки
+    static constexpr size_t workingMemory(size_t blockSize) {
+        return 2 * (blockSize + WindowSize) + sizeof(int32_t) * ((size_t(1) << MAX_HASH_BITS) + WindowSize);
+    }
+
+    static uint32_t hash(const uint8_t* p, size_t hashBits) {
+        if constexpr (MinMatch == 4) return hash4(p, hashBits);
+        else return hash3(p, hashBits);
+    }
+
+    static void compress(const uint8_t* input, size_t inputSize, vector<uint8_t>& out, int level,
+                         const uint8_t* dict, size_t dictSize, LZ77Context* context);
+    static bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                           const uint8_t* dict, size_t dictSize, size_t rawSize);
 };
 
+// Сжатие блока LZ77
+template <size_t WindowSize, size_t MinMatch, size_t MaxMatch>
+void LZ77Kernel<WindowSize, MinMatch, MaxMatch>::compress(
+        const uint8_t* input, size_t inputSize, vector<uint8_t>& out, int level,
+        const uint8_t* dict, size_t dictSize, LZ77Context* context) {
+    // Для очень маленьких блоков (менее 64 байт) без словаря - не сжимаем
+    if (inputSize < 64 && dictSize == 0) {
+        out.push_back('U'); // Маркер несжатых данных
+        out.insert(out.end(), input, input + inputSize);
+        return;
+    }
+
+    // Словарь работает как уже просмотренная часть окна: поиск идёт по
+    // буферу "хвост словаря + блок", токены пишутся только для блока
+    if (dictSize > WindowSize) {
+        dict += dictSize - WindowSize;
+        dictSize = WindowSize;
+    }
+    LZ77Context local;
+    LZ77Context& ctx = context ? *context : local;
+
+    vector<uint8_t>& joined = ctx.joined;
+    const uint8_t* data = input;
+    size_t size = inputSize;
+    size_t pos = 0;
+    if (dictSize > 0) {
+        joined.clear();
+        joined.reserve(dictSize + inputSize);
+        joined.insert(joined.end(), dict, dict + dictSize);
+        joined.insert(joined.end(), input, input + inputSize);
+        data = joined.data();
+        size = joined.size();
+        pos = dictSize;
+    }
+    const size_t outStart = out.size();
+
+    // Запись маркера сжатых данных
+    // Токены не длиннее блока: дальше блок хранится как есть
+    out.push_back('C');
+    out.reserve(outStart + inputSize + TOKEN_SIZE + 1);
+
+    level = max(LZ77_MIN_LEVEL, min(level, LZ77_MAX_LEVEL));
+    const size_t maxDepth = level == LZ77_MAX_LEVEL ? WindowSize : CHAIN_DEPTH[level];
+
+    LZ77Stats stats;
+    bool expanded = false;
+
+    // head — последняя позиция с данным хешем, prev — предыдущая в цепочке.
+    // Разовый вызов берёт таблицу по размеру данных: её очистка не должна
+    // стоить дороже самого сжатия. Переиспользуемый контекст держит полную
+    // таблицу и не чистит её: позиции хранятся со смещением base, и всё,
+    // что ниже base, осталось от прошлых блоков
+    size_t hashBits = MAX_HASH_BITS;
+    if (!context) {
+        hashBits = MIN_HASH_BITS;
+        while (hashBits < MAX_HASH_BITS && (size_t(1) << hashBits) < size) ++hashBits;
+    }
+    if (ctx.hashBits != hashBits || ctx.prev.size() != WindowSize ||
+        size > size_t(INT32_MAX - ctx.base)) {
+        ctx.head.assign(size_t(1) << hashBits, -1);
+        ctx.prev.assign(WindowSize, -1);
+        ctx.hashBits = hashBits;
+        ctx.base = 0;
+    }
+    vector<int32_t>& head = ctx.head;
+    vector<int32_t>& prev = ctx.prev;
+    const int64_t base = ctx.base;
+    ctx.base += static_cast<int32_t>(size);
+
+    auto insert = [&](size_t p) {
+        if (p + MinMatch > size) return;
+        uint32_t h = hash(data + p, hashBits);
+        prev[p & (WindowSize - 1)] = head[h];
+        head[h] = static_cast<int32_t>(base + p);
+    };
+
+    for (size_t p = 0; p < pos; ++p) {
+        insert(p);
+    }
+
+    {
+        // Один таймер на весь разбор блока: замер на каждой позиции стоил бы
+        // двух чтений часов на байт
+        StageTimer parseTimer(stats.parseMs);
+        while (pos < size) {
+            size_t bestDistance = 0;
+            size_t bestLength = 0;
+
+            // Совпадение оставляет хотя бы один байт под nextChar
+            size_t maxLength = min(MaxMatch, size - pos - 1);
+
+            // Поиск наилучшего совпадения в окне
+            if (maxLength >= MinMatch) {
+                int64_t candidate = head[hash(data + pos, hashBits)] - base;
+                size_t depth = maxDepth;
+                while (candidate >= 0 && pos - candidate <= WindowSize && depth-- > 0) {
+                    ++stats.probes;
+                    const uint8_t* a = data + candidate;
+                    const uint8_t* b = data + pos;
+                    size_t len = 0;
+                    while (len < maxLength && a[len] == b[len]) {
+                        len++;
+                    }
+
+                    // Строгое сравнение: из равных выбирается ближайшее совпадение
+                    if (len > bestLength) {
+                        bestLength = len;
+                        bestDistance = pos - candidate;
+                        if (len == maxLength) break;
+                    }
+
+                    int64_t next = prev[candidate & (WindowSize - 1)] - base;
+                    if (next >= candidate) break; // Ячейка уже перезаписана
+                    candidate = next;
+                }
+            }
+            ++stats.positions;
+
+            Token token;
+            if (bestLength >= MinMatch) {
+                ++stats.matches;
+                stats.matchBytes += bestLength;
+                token.offset = static_cast<uint16_t>(bestDistance - 1);
+                token.length = static_cast<uint16_t>(bestLength);
+                token.nextChar = data[pos + bestLength];
+
+                for (size_t i = 0; i <= bestLength; i++) {
+                    insert(pos + i);
+                }
+                pos += bestLength + 1;
+            } else {
+                ++stats.literals;
+                token.offset = 0;
+                token.length = 0;
+                token.nextChar = data[pos];
+
+                insert(pos);
+                pos++;
+            }
+
+            // Запись токена
+            appendToken(out, token);
+            if (out.size() - outStart > inputSize) {
+                expanded = true;
+                break;
+            }
+        }
+    }
+
+    recordStats(stats);
+
+    // Несжимаемые данные (или маленькая запись со словарём): токены уже
+    // длиннее самого блока, поэтому поиск прерван и блок хранится как есть
+    if (expanded) {
+        out.resize(outStart);
+        out.push_back('U');
+        out.insert(out.end(), input, input + inputSize);
+    }
+}
+
+// Распаковка блока LZ77, результат дописывается в out
+template <size_t WindowSize, size_t MinMatch, size_t MaxMatch>
+bool LZ77Kernel<WindowSize, MinMatch, MaxMatch>::decompress(
+        const uint8_t* data, size_t size, vector<uint8_t>& out,
+        const uint8_t* dict, size_t dictSize, size_t rawSize) {
+    if (size == 0) {
+        cerr << "Error: Invalid file format!" << endl;
+        return false;
+    }
+
+    // Проверка маркера
+    uint8_t marker = data[0];
+    if (marker == 'U') {
+        // Несжатые данные
+        if (rawSize != CODEC_UNKNOWN_SIZE && size - 1 != rawSize) {
+            cerr << "Error: Block size does not match the frame!" << endl;
+            return false;
+        }
+        out.insert(out.end(), data + 1, data + size);
+        return true;
+    } else if (marker != 'C') {
+        cerr << "Error: Invalid file format!" << endl;
+        return false;
+    }
+
+    const size_t base = out.size();
+    if (dictSize > WindowSize) {
+        dict += dictSize - WindowSize;
+        dictSize = WindowSize;
+    }
+
+    for (size_t p = 1; p + TOKEN_SIZE <= size; p += TOKEN_SIZE) {
+        size_t distance = (size_t(data[p]) | (size_t(data[p + 1]) << 8)) + 1;
+        size_t length = size_t(data[p + 2]) | (size_t(data[p + 3]) << 8);
+        uint8_t nextChar = data[p + 4];
+
+        // Токен дописывает length + 1 байт; больше rawSize блок не даёт
+        if (length + 1 > rawSize - (out.size() - base)) {
+            cerr << "Error: Block is longer than the frame!" << endl;
+            return false;
+        }
+
+        if (length > 0) {
+            // Обработка совпадения; источник может перекрываться с приёмником
+            size_t produced = out.size() - base;
+            if (distance > produced + dictSize) {
+                cerr << "Error: Invalid match offset!" << endl;
+                return false;
+            }
+            for (size_t i = 0; i < length; i++, produced++) {
+                // Начало совпадения может лежать в словаре
+                uint8_t byte = distance > produced ? dict[dictSize - (distance - produced)]
+                                                   : out[out.size() - distance];
+                out.push_back(byte);
+            }
+        }
+
+        // Добавление нового символа
+        out.push_back(nextChar);
+    }
+    if (rawSize != CODEC_UNKNOWN_SIZE && out.size() - base != rawSize) {
+        cerr << "Error: Block is shorter than the frame!" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Пресеты ядра: исходный формат (окно 4 КиБ, совпадения 3..18) и
+// широкое окно 64 КиБ с совпадениями 4..258 для крупных блоков
+using LZ77Default = LZ77Kernel<LZ77_WINDOW_SIZE, 3, 18>;
+using LZ77Wide = LZ77Kernel<65536, 4, 258>;
+
+void lz77Compress(const uint8_t* input, size_t inputSize, vector<uint8_t>& out, int level,
+                  const uint8_t* dict, size_t dictSize, LZ77Context* context) {
+    LZ77Default::compress(input, inputSize, out, level, dict, dictSize, context);
+}
+
+bool lz77Decompress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                    const uint8_t* dict, size_t dictSize, size_t rawSize) {
+    return LZ77Default::decompress(data, size, out, dict, dictSize, rawSize);
+}
+
 // Функция сжатия LZ77
 void compressFileLZ77(const string& inputPath, const string& outputPath) {
     ifstream in(inputPath, ios::binary);
@@ -32,85 +330,39 @@ void compressFileLZ77(const string& inputPath, const string& outputPath) {
     size_t fileSize = in.tellg();
     in.seekg(0, ios::beg);
     
-    // Для очень маленьких файлов (менее 64 байт) - не сжимаем
-    if (fileSize < 64) {
-        ofstream out(outputPath, ios::binary);
-        out.put('U'); // Маркер несжатых данных
-        out << in.rdbuf();
-        cout << "Small file stored without compression (" << fileSize << " bytes)" << endl;
-        return;
-    }
-    
     ofstream out(outputPath, ios::binary);
     if (!out) {
         cerr << "Error: Cannot open output file!" << endl;
         return;
     }
     
-    // Запись маркера сжатых данных
-    out.put('C');
+    IOStats io;
     
     // Буфер данных
     vector<uint8_t> data(fileSize);
-    in.read(reinterpret_cast<char*>(data.data()), fileSize);
+    {
+        StageTimer t(io.readMs);
+        in.read(reinterpret_cast<char*>(data.data()), fileSize);
+    }
     in.close();
+    io.bytesRead = fileSize;
     
-    // Скользящее окно и буфер предпросмотра
-    deque<uint8_t> window;
-    size_t pos = 0;
+    vector<uint8_t> packed;
+    lz77Compress(data.data(), data.size(), packed);
     
-    while (pos < data.size()) {
-        size_t bestOffset = 0;
-        size_t bestLength = 0;
-        
-        // Поиск наилучшего совпадения в окне
-        for (size_t i = 0; i < window.size(); i++) {
-            size_t len = 0;
-            while (len < MAX_MATCH_LEN && 
-                   pos + len < data.size() && 
-                   window[window.size() - i - 1 + len] == data[pos + len]) {
-                len++;
-            }
-            
-            if (len > bestLength && len >= MIN_MATCH_LEN) {
-                bestLength = len;
-                bestOffset = i;
-            }
-        }
-        
-        Token token;
-        if (bestLength >= MIN_MATCH_LEN) {
-            token.offset = static_cast<uint16_t>(bestOffset);
-            token.length = static_cast<uint16_t>(bestLength);
-            token.nextChar = (pos + bestLength < data.size()) ? data[pos + bestLength] : 0;
-            
-            // Добавление в окно
-            size_t addCount = min(bestLength + 1, data.size() - pos);
-            for (size_t i = 0; i < addCount; i++) {
-                window.push_back(data[pos + i]);
-                if (window.size() > WINDOW_SIZE) {
-                    window.pop_front();
-                }
-            }
-            pos += addCount;
-        } else {
-            token.offset = 0;
-            token.length = 0;
-            token.nextChar = data[pos];
-            
-            window.push_back(data[pos]);
-            if (window.size() > WINDOW_SIZE) {
-                window.pop_front();
-            }
-            pos++;
-        }
-        
-        // Запись токена
-        out.write(reinterpret_cast<const char*>(&token), sizeof(token));
+    {
+        StageTimer t(io.writeMs);
+        out.write(reinterpret_cast<const char*>(packed.data()), packed.size());
     }
+    io.bytesWritten = packed.size();
+    recordStats(io);
     
-    cout << "File compressed successfully: " << fileSize << " -> " 
-         << out.tellp() << " bytes" << endl;
+    if (fileSize < 64) {
+        cout << "Small file stored without compression (" << fileSize << " bytes)" << endl;
+    } else {
+        cout << "File compressed successfully: " << fileSize << " -> " 
+             << packed.size() << " bytes" << endl;
+    }
 }
 
 // Функция распаковки LZ77
@@ -121,16 +373,16 @@ void decompressFileLZ77(const string& inputPath, const string& outputPath) {
         return;
     }
     
-    // Проверка маркера
-    char marker = in.get();
-    if (marker == 'U') {
-        // Несжатые данные
-        ofstream out(outputPath, ios::binary);
-        out << in.rdbuf();
-        cout << "Small file extracted successfully" << endl;
-        return;
-    } else if (marker != 'C') {
-        cerr << "Error: Invalid file format!" << endl;
+    IOStats io;
+    vector<uint8_t> packed;
+    {
+        StageTimer t(io.readMs);
+        packed.assign(istreambuf_iterator<char>(in), {});
+    }
+    io.bytesRead = packed.size();
+    
+    vector<uint8_t> output;
+    if (!lz77Decompress(packed.data(), packed.size(), output)) {
         return;
     }
     
@@ -140,36 +392,57 @@ void decompressFileLZ77(const string& inputPath, const string& outputPath) {
         return;
     }
     
-    // Буфер данных
-    vector<uint8_t> output;
-    vector<uint8_t> window;
-    
-    Token token;
-    while (in.read(reinterpret_cast<char*>(&token), sizeof(token))) {
-        if (token.length > 0) {
-            // Обработка совпадения
-            size_t start = window.size() - token.offset;
-            for (size_t i = 0; i < token.length; i++) {
-                uint8_t byte = window[start + i];
-                output.push_back(byte);
-                window.push_back(byte);
-                if (window.size() > WINDOW_SIZE) {
-                    window.erase(window.begin());
-                }
-            }
-        }
-        
-        // Добавление нового символа
-        if (token.nextChar != 0) {
-            output.push_back(token.nextChar);
-            window.push_back(token.nextChar);
-            if (window.size() > WINDOW_SIZE) {
-                window.erase(window.begin());
-            }
-        }
-    }
-    
     // Запись распакованных данных
-    out.write(reinterpret_cast<const char*>(output.data()), output.size());
+    {
+        StageTimer t(io.writeMs);
+        out.write(reinterpret_cast<const char*>(output.data()), output.size());
+    }
+    io.bytesWritten = output.size();
+    recordStats(io);
     cout << "File decompressed successfully: " << output.size() << " bytes" << endl;
-}
\ No newline at end of file
+}
+
+template <typename Kernel, CodecId Id>
+class LZ77Codec : public Codec {
+    const char* name_;
+
+public:
+    explicit LZ77Codec(const char* name) : name_(name) {}
+
+    CodecId id() const override { return Id; }
+    const char* name() const override { return name_; }
+
+    // Словарь — префикс окна
+    void compress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                  const CodecParams& params, CodecContext* context) const override {
+        const Dictionary* dict = params.dictionary;
+        Kernel::compress(data, size, out, params.level,
+                         dict ? dict->content.data() : nullptr, dict ? dict->content.size() : 0,
+                         context ? &context->scratch<LZ77Context>(Id) : nullptr);
+    }
+
+    bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize,
+                    const CodecParams& params) const override {
+        const Dictionary* dict = params.dictionary;
+        return Kernel::decompress(data, size, out,
+                                  dict ? dict->content.data() : nullptr,
+                                  dict ? dict->content.size() : 0, rawSize);
+    }
+
+    size_t workingMemory(size_t blockSize) const override {
+        return Kernel::workingMemory(blockSize);
+    }
+
+    bool usesDictionary() const override { return true; }
+};
+
+struct LZ77DefaultCodec : LZ77Codec<LZ77Default, CodecId::LZ77> {
+    LZ77DefaultCodec() : LZ77Codec("LZ77") {}
+};
+
+struct LZ77WideCodec : LZ77Codec<LZ77Wide, CodecId::LZ77Wide> {
+    LZ77WideCodec() : LZ77Codec("LZ77-64K") {}
+};
+
+static CodecRegistration<LZ77DefaultCodec> registerLZ77;
+static CodecRegistration<LZ77WideCodec> registerLZ77Wide;
@@ -0,0 +1,41 @@
+// lz77.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../codec/codec.h"
+
+const size_t LZ77_WINDOW_SIZE = 4096;
+
+const int LZ77_MIN_LEVEL = CODEC_MIN_LEVEL;
+const int LZ77_MAX_LEVEL = CODEC_MAX_LEVEL;
+const int LZ77_DEFAULT_LEVEL = CODEC_DEFAULT_LEVEL;
+
+// Хеш-таблицы и буферы, переиспользуемые между блоками одного потока
+struct LZ77Context : CodecScratch {
+    std::vector<int32_t> head;
+    std::vector<int32_t> prev;
+    std::vector<uint8_t> joined;  // Хвост словаря + блок
+    size_t hashBits = 0;
+    int32_t base = 0;             // Позиции ниже base остались от прошлых блоков
+};
+
+// Сжатие блока в памяти; level задаёт глубину поиска по хеш-цепочкам.
+// dict — обученный префикс: совпадения могут ссылаться в его последние
+// LZ77_WINDOW_SIZE байт. context — таблицы с прошлых вызовов (не
+// разделяется между потоками). Результат дописывается в конец out.
+void lz77Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                  int level = LZ77_MAX_LEVEL, const uint8_t* dict = nullptr, size_t dictSize = 0,
+                  LZ77Context* context = nullptr);
+// Распаковка блока; false — повреждённые данные. dict — тот же префикс.
+// rawSize — ожидаемый размер: результат длиннее или короче отвергается,
+// токены сверх него не разворачиваются
+bool lz77Decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                    const uint8_t* dict = nullptr, size_t dictSize = 0,
+                    size_t rawSize = CODEC_UNKNOWN_SIZE);
+
+void compressFileLZ77(const std::string& inputPath, const std::string& outputPath);
+void decompressFileLZ77(const std::string& inputPath, const std::string& outputPath);
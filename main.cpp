@@ -10,18 +10,26 @@
 #include <map>
 #include <sstream>
 #include <filesystem>
+#include <thread>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "batch/batch.h"
+#include "codec/codec.h"
+#include "dict/dict.h"
+#include "huffman/huffman.h"
+#include "lz77/lz77.h"
+#include "memory/memory.h"
+#include "stats/stats.h"
+#include "stream/stream.h"
 
 using namespace std;
 namespace fs = filesystem;
 
-// Function declarations
-void encodeFile(const string& inputFile, const string& outputFile);
-void decodeFile(const string& inputFile, const string& outputFile);
-void compressFileLZ77(const string& inputPath, const string& outputPath);
-void decompressFileLZ77(const string& inputPath, const string& outputPath);
-void compressFileRLE(const string& inputPath, const string& outputPath);
-void decompressFileRLE(const string& inputPath, const string& outputPath);
-
 // Function to get file size
 uint64_t getFileSize(const string& filePath) {
     ifstream file(filePath, ios::binary | ios::ate);
@@ -32,8 +40,6 @@ uint64_t getFileSize(const string& filePath) {
 // Structure to store compression results
 struct CompressionResult {
     string algorithm;
-    string compressedPath;
-    string decompressedPath;
     uint64_t originalSize;
     uint64_t compressedSize;
     uint64_t decompressedSize;
@@ -41,26 +47,31 @@ struct CompressionResult {
     double decompressionTime;
     double ratio;
     bool integrity;
+    CodecStats compressionStats;
+    CodecStats decompressionStats;
 };
 
-// Function to compare two files
-bool compareFiles(const string& file1, const string& file2) {
-    ifstream f1(file1, ios::binary);
-    ifstream f2(file2, ios::binary);
-    
-    if (!f1 || !f2) return false;
-    
-    // Compare file sizes first
-    f1.seekg(0, ios::end);
-    f2.seekg(0, ios::end);
-    if (f1.tellg() != f2.tellg()) return false;
-    
-    // Compare content
-    f1.seekg(0);
-    f2.seekg(0);
-    return equal(istreambuf_iterator<char>(f1),
-                 istreambuf_iterator<char>(),
-                 istreambuf_iterator<char>(f2));
+// Runs one codec operation and returns the counters it recorded.
+// Peak heap usage above the starting level is measured even without --stats.
+template <typename Operation>
+CodecStats runMeasured(Operation&& operation) {
+    resetStats();
+    size_t heapBefore = allocatedBytes();
+    resetPeakAllocated();
+    PerfCounters perf;
+    perf.start();
+    operation();
+    recordStats(perf.stop());
+    CodecStats stats = snapshotStats();
+    stats.memory.peakBytes = peakAllocatedBytes() - heapBefore;
+    return stats;
+}
+
+// Function to read a whole file into memory
+vector<uint8_t> readFileBytes(const string& filePath) {
+    ifstream file(filePath, ios::binary);
+    if (!file) throw runtime_error("cannot open " + filePath);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), {});
 }
 
 // Function to display ASCII bar chart
@@ -88,22 +99,25 @@ void displayStatistics(const vector<CompressionResult>& results) {
     maxTime = max(maxTime, 1.0); // Ensure we don't divide by zero
     
     cout << "\n\n";
-    cout << "╔══════════════════════════════════════════════════════════════════════════╗\n";
-    cout << "║                      COMPRESSION ALGORITHM COMPARISON                   ║\n";
-    cout << "╠═══════════════╦════════════╦════════════╦════════════╦════════╦═════════╣\n";
-    cout << "║ Algorithm     ║ Compressed ║ Ratio (%)  ║ Comp Time  ║ Dec Time║ Integrity║\n";
-    cout << "╠═══════════════╬════════════╬════════════╬════════════╬════════╬═════════╣\n";
+    cout << "╔════════════════════════════════════════════════════════════════════════════════════════════════╗\n";
+    cout << "║                                COMPRESSION ALGORITHM COMPARISON                                ║\n";
+    cout << "╠═══════════════╦════════════╦════════════╦════════════╦════════════╦══════════╦══════════╦═════════╣\n";
+    cout << "║ Algorithm     ║ Compressed ║ Ratio (%)  ║ Comp Time  ║ Comp Peak  ║ Dec Time ║ Dec Peak ║Integrity║\n";
+    cout << "║               ║            ║            ║ (ms)       ║ (KiB)      ║ (ms)     ║ (KiB)    ║         ║\n";
+    cout << "╠═══════════════╬════════════╬════════════╬════════════╬════════════╬══════════╬══════════╬═════════╣\n";
     
     for (const auto& res : results) {
         cout << "║ " << left << setw(13) << res.algorithm << " ║ "
              << right << setw(10) << res.compressedSize << " ║ "
              << setw(10) << fixed << setprecision(2) << res.ratio << " ║ "
              << setw(10) << fixed << setprecision(3) << res.compressionTime << " ║ "
+             << setw(10) << res.compressionStats.memory.peakBytes / 1024 << " ║ "
              << setw(8) << fixed << setprecision(3) << res.decompressionTime << " ║ "
+             << setw(8) << res.decompressionStats.memory.peakBytes / 1024 << " ║ "
              << setw(7) << (res.integrity ? "✓" : "✗") << " ║\n";
     }
     
-    cout << "╚═══════════════╩════════════╩════════════╩════════════╩════════╩═════════╝\n";
+    cout << "╚═══════════════╩════════════╩════════════╩════════════╩════════════╩══════════╩══════════╩═════════╝\n";
     
     // Bar chart for compression ratio
     cout << "\n\nCOMPRESSION RATIO COMPARISON:\n";
@@ -210,57 +224,51 @@ void displayStatistics(const vector<CompressionResult>& results) {
     cout << "└───────────────────────────────────────────────────────────┘\n";
 }
 
-// Function to test all compression algorithms
-void testAllAlgorithms(const string& inputFile) {
+// Function to test all compression algorithms (in memory, no temporary files)
+void testAllAlgorithms(const string& inputFile, int level = CODEC_DEFAULT_LEVEL,
+                       const Dictionary* dict = nullptr) {
     vector<CompressionResult> results;
-    vector<pair<string, string>> algorithms = {
-        {"Huffman", ".huff"},
-        {"LZ77", ".lz77"},
-        {"RLE", ".rle"}
-    };
+    CodecParams params;
+    params.level = level;
+    params.dictionary = dict;
+
+    vector<uint8_t> original = readFileBytes(inputFile);
 
-    for (const auto& algo : algorithms) {
+    for (const auto& codec : CodecRegistry::instance().all()) {
         CompressionResult result;
-        result.algorithm = algo.first;
-        result.originalSize = getFileSize(inputFile);
+        result.algorithm = codec->name();
+        result.originalSize = original.size();
         
-        // Generate filenames
-        string compressedFile = inputFile + algo.second;
-        string decompressedFile = inputFile + ".decompressed" + algo.second;
+        vector<uint8_t> compressed;
+        vector<uint8_t> decompressed;
         
         // Compression
         auto startComp = chrono::high_resolution_clock::now();
         
-        if (algo.first == "Huffman") {
-            encodeFile(inputFile, compressedFile);
-        } else if (algo.first == "LZ77") {
-            compressFileLZ77(inputFile, compressedFile);
-        } else if (algo.first == "RLE") {
-            compressFileRLE(inputFile, compressedFile);
-        }
+        result.compressionStats = runMeasured([&] {
+            codec->compress(original.data(), original.size(), compressed, params, nullptr);
+        });
         
         auto endComp = chrono::high_resolution_clock::now();
         result.compressionTime = chrono::duration<double, milli>(endComp - startComp).count();
-        result.compressedSize = getFileSize(compressedFile);
+        result.compressedSize = compressed.size();
         result.ratio = (1.0 - static_cast<double>(result.compressedSize)/result.originalSize) * 100.0;
         
         // Decompression
         auto startDecomp = chrono::high_resolution_clock::now();
         
-        if (algo.first == "Huffman") {
-            decodeFile(compressedFile, decompressedFile);
-        } else if (algo.first == "LZ77") {
-            decompressFileLZ77(compressedFile, decompressedFile);
-        } else if (algo.first == "RLE") {
-            decompressFileRLE(compressedFile, decompressedFile);
-        }
+        bool decoded = false;
+        result.decompressionStats = runMeasured([&] {
+            decoded = codec->decompress(compressed.data(), compressed.size(), decompressed,
+                                        original.size(), params);
+        });
         
         auto endDecomp = chrono::high_resolution_clock::now();
         result.decompressionTime = chrono::duration<double, milli>(endDecomp - startDecomp).count();
-        result.decompressedSize = getFileSize(decompressedFile);
+        result.decompressedSize = decompressed.size();
         
         // Integrity check
-        result.integrity = compareFiles(inputFile, decompressedFile);
+        result.integrity = decoded && decompressed == original;
         
         // Store results
         results.push_back(result);
@@ -269,38 +277,320 @@ void testAllAlgorithms(const string& inputFile) {
     // Display comprehensive statistics
     displayStatistics(results);
     
-    // Cleanup temporary files
-    for (const auto& algo : algorithms) {
-        string compressedFile = inputFile + algo.second;
-        string decompressedFile = inputFile + ".decompressed" + algo.second;
-        remove(compressedFile.c_str());
-        remove(decompressedFile.c_str());
+    // Per-stage counters (--stats)
+    if (statsEnabled()) {
+        cout << "\n\nPER-STAGE STATISTICS:\n";
+        for (const auto& res : results) {
+            printStatsReport(cout, res.algorithm + " compress", res.compressionStats);
+            printStatsReport(cout, res.algorithm + " decompress", res.decompressionStats);
+        }
+    }
+}
+
+// Registered codec names for usage text, e.g. "huffman|lz77|rle"
+string codecNames() {
+    string names;
+    for (const auto& codec : CodecRegistry::instance().all()) {
+        if (!names.empty()) names += "|";
+        string name = codec->name();
+        transform(name.begin(), name.end(), name.begin(),
+                  [](unsigned char c) { return static_cast<char>(tolower(c)); });
+        names += name;
+    }
+    return names;
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage:\n"
+         << "  " << program << "                        interactive menu\n"
+         << "  " << program << " compress [-c " << codecNames() << "] [-l 1-9] [-T threads] [-B block_kib] [in [out]]\n"
+         << "  " << program << " decompress [-T threads] [in [out]]\n"
+         << "  " << program << " encode|decode [in [out]]   single-pass adaptive Huffman, no container\n"
+         << "  " << program << " bench [-l 1-9] [-D dict] file...\n"
+         << "  " << program << " train -o dict [-s max_bytes] sample_file_or_dir...\n"
+         << "  " << program << " batch compress|decompress [compress options] src_dir dst_dir\n"
+         << "compress/decompress also take -D dict to use a trained dictionary.\n"
+         << "compress/decompress/batch take --memory-limit bytes[K|M|G]: block size and\n"
+         << "threads are reduced to keep the heap under the limit.\n"
+         << "compress/batch take --dedup to replace repeated chunks with references;\n"
+         << "--dedup-history bytes[K|M|G] sets how far back they may point (default 64M).\n"
+         << "Options: --stats per-stage counters (stderr), --perf adds hardware counters\n"
+         << "Missing or \"-\" in/out means stdin/stdout.\n";
+}
+
+// Parses an integer option value, throws on garbage
+int parseIntOption(const string& option, const string& value, int minValue, int maxValue) {
+    size_t used = 0;
+    int parsed = 0;
+    try {
+        parsed = stoi(value, &used);
+    } catch (const exception&) {
+        used = 0;
+    }
+    if (used != value.size() || parsed < minValue || parsed > maxValue) {
+        throw invalid_argument("invalid value for " + option + ": " + value);
+    }
+    return parsed;
+}
+
+// Parses a byte count with an optional K/M/G suffix (binary units), e.g. "512M"
+size_t parseByteSize(const string& option, const string& value) {
+    size_t used = 0;
+    unsigned long long parsed = 0;
+    try {
+        parsed = stoull(value, &used);
+    } catch (const exception&) {
+        used = 0;
+    }
+    int shift = 0;
+    if (used > 0 && used + 1 == value.size()) {
+        switch (toupper(static_cast<unsigned char>(value[used]))) {
+            case 'K': shift = 10; break;
+            case 'M': shift = 20; break;
+            case 'G': shift = 30; break;
+            default: used = 0; break;
+        }
+        if (used > 0) ++used;
+    }
+    if (used == 0 || used != value.size() || parsed == 0 || parsed > (SIZE_MAX >> shift)) {
+        throw invalid_argument("invalid value for " + option + ": " + value);
+    }
+    return static_cast<size_t>(parsed) << shift;
+}
+
+// Function to collect regular files under a path (recursively for directories)
+void collectFiles(const string& path, vector<string>& files) {
+    if (fs::is_directory(path)) {
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file()) files.push_back(entry.path().string());
+        }
+    } else {
+        files.push_back(path);
     }
 }
 
-int main() {
+// Builds a dictionary from sample records and writes it to outputPath
+void trainCommand(const vector<string>& samplePaths, const string& outputPath, size_t maxSize) {
+    vector<string> files;
+    for (const auto& path : samplePaths) collectFiles(path, files);
+    if (files.empty()) throw invalid_argument("train needs sample files");
+
+    vector<vector<uint8_t>> samples;
+    uint64_t totalBytes = 0;
+    for (const auto& file : files) {
+        samples.push_back(readFileBytes(file));
+        totalBytes += samples.back().size();
+    }
+
+    Dictionary dict = trainDictionary(samples, maxSize);
+
+    ofstream out(outputPath, ios::binary);
+    if (!out) throw runtime_error("cannot create " + outputPath);
+    saveDictionary(dict, out);
+
+    cerr << "Trained dictionary " << dict.id << " from " << samples.size() << " samples ("
+         << totalBytes << " bytes): " << dict.content.size() << " byte prefix\n";
+}
+
+// Non-interactive mode: compress/decompress stream through pipes, bench runs in memory
+int runCommand(const string& command, const vector<string>& args) {
+    StreamOptions options;
+    vector<string> paths;
+    string dictPath;
+    string outputPath;
+    size_t dictSize = LZ77_WINDOW_SIZE;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        auto value = [&]() -> const string& {
+            if (i + 1 >= args.size()) throw invalid_argument("missing value for " + arg);
+            return args[++i];
+        };
+        if (arg == "-c") {
+            const Codec* codec = CodecRegistry::instance().find(value());
+            if (!codec) throw invalid_argument("unknown codec: " + args[i]);
+            options.codec = codec->id();
+        } else if (arg == "-l") {
+            options.level = parseIntOption(arg, value(), CODEC_MIN_LEVEL, CODEC_MAX_LEVEL);
+        } else if (arg == "-T") {
+            int threads = parseIntOption(arg, value(), 0, 256);
+            options.threads = threads > 0 ? threads : max(1u, thread::hardware_concurrency());
+        } else if (arg == "-B") {
+            options.blockSize = static_cast<size_t>(parseIntOption(arg, value(), 1, 65536)) << 10;
+        } else if (arg == "-D") {
+            dictPath = value();
+        } else if (arg == "-o") {
+            outputPath = value();
+        } else if (arg == "--memory-limit") {
+            options.memoryLimit = parseByteSize(arg, value());
+        } else if (arg == "--dedup") {
+            options.dedup = true;
+        } else if (arg == "--dedup-history") {
+            options.dedup = true;
+            options.dedupHistory = parseByteSize(arg, value());
+        } else if (arg == "-s") {
+            dictSize = static_cast<size_t>(parseIntOption(arg, value(), 1, 1 << 24));
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            throw invalid_argument("unknown option: " + arg);
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (command == "train") {
+        if (outputPath.empty()) throw invalid_argument("train needs -o dict");
+        trainCommand(paths, outputPath, dictSize);
+        return 0;
+    }
+
+    Dictionary dict;
+    if (!dictPath.empty()) {
+        ifstream dictFile(dictPath, ios::binary);
+        if (!dictFile) throw runtime_error("cannot open " + dictPath);
+        dict = loadDictionary(dictFile);
+        options.dictionary = &dict;
+    }
+
+    if (command == "batch") {
+        if (paths.size() != 3 || (paths[0] != "compress" && paths[0] != "decompress")) {
+            throw invalid_argument("batch needs compress|decompress, src_dir and dst_dir");
+        }
+        BatchMode mode = paths[0] == "compress" ? BatchMode::Compress : BatchMode::Decompress;
+        BatchSummary summary;
+        CodecStats stats = runMeasured([&] {
+            summary = processDirectory(mode, paths[1], paths[2], options);
+        });
+        printBatchSummary(cout, mode, summary);
+        if (statsEnabled()) {
+            printStatsReport(cout, "batch " + paths[0], stats);
+        }
+        return summary.failed == 0 ? 0 : 1;
+    }
+
+    if (command == "bench") {
+        if (paths.empty()) throw invalid_argument("bench needs at least one file");
+        for (const auto& path : paths) {
+            cout << "\n" << path << ":";
+            testAllAlgorithms(path, options.level, options.dictionary);
+        }
+        return 0;
+    }
+
+    if (paths.size() > 2) throw invalid_argument("too many arguments");
+
+    ifstream inFile;
+    ofstream outFile;
+    istream* in = &cin;
+    ostream* out = &cout;
+    if (!paths.empty() && paths[0] != "-") {
+        inFile.open(paths[0], ios::binary);
+        if (!inFile) throw runtime_error("cannot open " + paths[0]);
+        in = &inFile;
+    }
+    if (paths.size() > 1 && paths[1] != "-") {
+        outFile.open(paths[1], ios::binary);
+        if (!outFile) throw runtime_error("cannot create " + paths[1]);
+        out = &outFile;
+    }
+
+    CodecStats stats = runMeasured([&] {
+        if (command == "compress") {
+            compressStream(*in, *out, options);
+        } else if (command == "encode") {
+            if (!huffmanEncodeStream(*in, *out)) throw runtime_error("Huffman stream encoding failed");
+        } else if (command == "decode") {
+            if (!huffmanDecodeStream(*in, *out)) throw runtime_error("corrupt Huffman stream");
+        } else {
+            decompressStream(*in, *out, options.threads, options.dictionary, options.memoryLimit);
+        }
+    });
+
+    // stdout may carry data, so the report goes to stderr
+    if (statsEnabled()) {
+        printStatsReport(cerr, command, stats);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
     int choice;
     string inputFile, outputFile;
 
+    // --stats prints per-stage counters, --perf adds hardware counters
+    string command;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            setStatsEnabled(true);
+        } else if (arg == "--perf") {
+            setStatsEnabled(true);
+            setHardwareCountersEnabled(true);
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (command.empty()) {
+            command = arg;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (!command.empty()) {
+        if (command != "compress" && command != "decompress" && command != "encode" &&
+            command != "decode" && command != "bench" && command != "train" &&
+            command != "batch") {
+            cerr << "Unknown command: " << command << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        ios::sync_with_stdio(false);
+        try {
+            return runCommand(command, args);
+        } catch (const invalid_argument& e) {
+            cerr << "Error: " << e.what() << "\n";
+            printUsage(argv[0]);
+            return 2;
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
     cout << "╔═══════════════════════════════════════════════════╗\n";
     cout << "║             ADVANCED FILE COMPRESSION SUITE       ║\n";
     cout << "╠═══════════════════════════════════════════════════╣\n";
     cout << "║ 1. Test all algorithms (comparison)               ║\n";
-    cout << "║ 2. Use Huffman compression                        ║\n";
-    cout << "║ 3. Use LZ77 compression                           ║\n";
-    cout << "║ 4. Use RLE compression                            ║\n";
+    const auto& codecs = CodecRegistry::instance().all();
+    for (size_t i = 0; i < codecs.size(); ++i) {
+        string item = to_string(i + 2) + ". Use " + codecs[i]->name() + " compression";
+        cout << "║ " << left << setw(50) << item << right << "║\n";
+    }
     cout << "║ 0. Exit                                           ║\n";
     cout << "╚═══════════════════════════════════════════════════╝\n";
     cout << "> ";
     cin >> choice;
 
     if (choice == 0) return 0;
+    if (choice < 0 || static_cast<size_t>(choice) > codecs.size() + 1) {
+        cerr << "Unknown menu item: " << choice << "\n";
+        return 1;
+    }
     
     cout << "\nEnter input file path: ";
     cin >> inputFile;
     
     if (choice == 1) {
-        testAllAlgorithms(inputFile);
+        try {
+            testAllAlgorithms(inputFile);
+        } catch (const exception& e) {
+            cerr << "\nError: " << e.what() << endl;
+            return 1;
+        }
         return 0;
     }
     
@@ -308,15 +598,17 @@ int main() {
     cin >> outputFile;
 
     try {
-        if (choice == 2) { 
-            encodeFile(inputFile, outputFile);
-        } 
-        else if (choice == 3) { 
-            compressFileLZ77(inputFile, outputFile);
-        } 
-        else if (choice == 4) { 
-            compressFileRLE(inputFile, outputFile);
-        }
+        // Same container as the compress command, so "decompress" restores it
+        StreamOptions options;
+        options.codec = codecs[choice - 2]->id();
+        ifstream in(inputFile, ios::binary);
+        if (!in) throw runtime_error("cannot open " + inputFile);
+        ofstream out(outputFile, ios::binary);
+        if (!out) throw runtime_error("cannot create " + outputFile);
+        CodecStats stats = runMeasured([&] {
+            compressStream(in, out, options);
+        });
+        out.close();
         
         uint64_t originalSize = getFileSize(inputFile);
         uint64_t compressedSize = getFileSize(outputFile);
@@ -329,6 +621,11 @@ int main() {
             double ratio = (1.0 - static_cast<double>(compressedSize)/originalSize) * 100.0;
             cout << "Compression ratio: " << fixed << setprecision(2) << ratio << "%\n";
         }
+        
+        if (statsEnabled()) {
+            cout << "\n";
+            printStatsReport(cout, "compress", stats);
+        }
     } 
     catch (const exception& e) {
         cerr << "\nError: " << e.what() << endl;
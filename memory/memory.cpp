@@ -0,0 +1,72 @@
+// memory.cpp
+#include "memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+// Заголовок перед блоком; выравнивание сохраняет гарантии malloc
+struct alignas(max_align_t) BlockHeader {
+    size_t size;
+};
+
+atomic<size_t> g_current{0};
+atomic<size_t> g_peak{0};
+}
+
+static void* allocateTracked(size_t size) {
+    void* raw = malloc(sizeof(BlockHeader) + size);
+    if (!raw) return nullptr;
+    static_cast<BlockHeader*>(raw)->size = size;
+
+    size_t now = g_current.fetch_add(size, memory_order_relaxed) + size;
+    size_t peak = g_peak.load(memory_order_relaxed);
+    while (now > peak && !g_peak.compare_exchange_weak(peak, now, memory_order_relaxed)) {
+    }
+    return static_cast<BlockHeader*>(raw) + 1;
+}
+
+static void releaseTracked(void* p) {
+    if (!p) return;
+    BlockHeader* header = static_cast<BlockHeader*>(p) - 1;
+    g_current.fetch_sub(header->size, memory_order_relaxed);
+    free(header);
+}
+
+// Как у стандартного operator new: вызываем new_handler, пока он есть
+static void* allocateOrThrow(size_t size) {
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = allocateTracked(size)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+static void* allocateNoThrow(size_t size) noexcept {
+    try {
+        return allocateOrThrow(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+size_t allocatedBytes() { return g_current.load(memory_order_relaxed); }
+size_t peakAllocatedBytes() { return g_peak.load(memory_order_relaxed); }
+void resetPeakAllocated() { g_peak.store(g_current.load(memory_order_relaxed), memory_order_relaxed); }
+
+void* operator new(size_t size) { return allocateOrThrow(size); }
+void* operator new[](size_t size) { return allocateOrThrow(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocateNoThrow(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocateNoThrow(size); }
+
+void operator delete(void* p) noexcept { releaseTracked(p); }
+void operator delete[](void* p) noexcept { releaseTracked(p); }
+void operator delete(void* p, size_t) noexcept { releaseTracked(p); }
+void operator delete[](void* p, size_t) noexcept { releaseTracked(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { releaseTracked(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { releaseTracked(p); }
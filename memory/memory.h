@@ -0,0 +1,13 @@
+// memory.h
+#pragma once
+
+#include <cstddef>
+
+// Учёт динамической памяти процесса. Глобальные operator new/delete
+// заменены в memory.cpp: каждый блок несёт свой размер, поэтому
+// текущий объём и пик известны без обращения к ОС (RSS).
+size_t allocatedBytes();
+// Максимум allocatedBytes() с последнего resetPeakAllocated()
+size_t peakAllocatedBytes();
+// Начинает новый замер пика с текущего объёма
+void resetPeakAllocated();
@@ -0,0 +1,67 @@
+// pool.cpp
+#include "pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(unsigned threads) {
+    threads = max(1u, threads);
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers_.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void WorkerPool::submit(function<void(unsigned)> job) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        jobs_.push_back(move(job));
+        ++pending_;
+    }
+    jobReady_.notify_one();
+}
+
+void WorkerPool::wait() {
+    unique_lock<mutex> lock(mutex_);
+    allDone_.wait(lock, [this] { return pending_ == 0; });
+    if (error_) {
+        exception_ptr error = error_;
+        error_ = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+void WorkerPool::workerLoop(unsigned index) {
+    while (true) {
+        function<void(unsigned)> job;
+        {
+            unique_lock<mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;
+            job = move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        try {
+            job(index);
+        } catch (...) {
+            lock_guard<mutex> lock(mutex_);
+            if (!error_) error_ = current_exception();
+        }
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (--pending_ == 0) allDone_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// pool.h
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков, общий для всех задач одного запуска. Задача получает
+// индекс исполнителя 0..size()-1, по которому берёт свой контекст
+// кодека, поэтому буферы и таблицы живут дольше одной задачи.
+class WorkerPool {
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void(unsigned)>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable allDone_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    void workerLoop(unsigned index);
+
+public:
+    explicit WorkerPool(unsigned threads);
+    ~WorkerPool();
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    void submit(std::function<void(unsigned)> job);
+    // Ждёт все поставленные задачи; первое исключение из задач
+    // пробрасывается здесь
+    void wait();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+};
@@ -0,0 +1,270 @@
+// rans.cpp
+#include "rans.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "../codec/codec.h"
+#include "../huffman/huffman.h"
+#include "../stats/stats.h"
+
+using namespace std;
+
+const uint32_t PROB_BITS = 12;                  // Размер таблицы: 4096 ячеек
+const uint32_t PROB_SCALE = 1u << PROB_BITS;
+const uint32_t RANS_L = 1u << 16;               // Нижняя граница состояния
+const size_t LANES = 4;                         // Чередующиеся состояния
+const size_t PADDING_WORDS = LANES;             // Запас для безусловного чтения
+
+// Ячейка таблицы декодирования: состояние обновляется без ветвлений
+// x = freq * (x >> PROB_BITS) + offset, где offset = slot - cum
+struct DecodeSlot {
+    uint16_t freq;
+    uint16_t offset;
+    uint8_t symbol;
+};
+
+template <typename T>
+static void appendValue(vector<uint8_t>& out, T value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+template <typename T>
+static bool readValue(const uint8_t*& pos, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - pos) < sizeof(value)) return false;
+    copy(pos, pos + sizeof(value), reinterpret_cast<uint8_t*>(&value));
+    pos += sizeof(value);
+    return true;
+}
+
+// Приводит частоты к сумме PROB_SCALE; встречающиеся символы получают >= 1
+static void normalizeFrequencies(const uint32_t* counts, size_t total, uint32_t* freqs) {
+    uint32_t sum = 0;
+    for (int c = 0; c < 256; ++c) {
+        freqs[c] = 0;
+        if (counts[c] == 0) continue;
+        uint64_t scaled = uint64_t(counts[c]) * PROB_SCALE / total;
+        freqs[c] = max<uint32_t>(1, static_cast<uint32_t>(scaled));
+        sum += freqs[c];
+    }
+
+    // Ошибка округления уходит в самые частые символы: там она дешевле всего
+    while (sum != PROB_SCALE) {
+        int largest = static_cast<int>(max_element(freqs, freqs + 256) - freqs);
+        if (sum < PROB_SCALE) {
+            freqs[largest] += PROB_SCALE - sum;
+            sum = PROB_SCALE;
+        } else {
+            // largest > 1: символов не больше 256, а сумма больше 4096
+            uint32_t cut = min(sum - PROB_SCALE, freqs[largest] - 1);
+            freqs[largest] -= cut;
+            sum -= cut;
+        }
+    }
+}
+
+void ransCompress(const uint8_t* data, size_t size, vector<uint8_t>& out) {
+    if (size < 32) {
+        out.push_back('U'); // Маркер несжатого блока
+        out.insert(out.end(), data, data + size);
+        return;
+    }
+
+    RansStats stats;
+    uint32_t counts[256];
+    {
+        StageTimer t(stats.histogramMs);
+        buildHistogram(data, size, counts);
+    }
+
+    uint32_t freqs[256];
+    uint32_t cums[256];
+    {
+        StageTimer t(stats.normalizeMs);
+        normalizeFrequencies(counts, size, freqs);
+        uint32_t cum = 0;
+        for (int c = 0; c < 256; ++c) {
+            cums[c] = cum;
+            cum += freqs[c];
+        }
+    }
+
+    out.push_back('R'); // Маркер блока rANS
+    appendValue(out, static_cast<uint32_t>(size));
+    uint16_t used = 0;
+    for (int c = 0; c < 256; ++c) used += freqs[c] > 0;
+    appendValue(out, used);
+    for (int c = 0; c < 256; ++c) {
+        if (freqs[c] == 0) continue;
+        out.push_back(static_cast<uint8_t>(c));
+        appendValue(out, static_cast<uint16_t>(freqs[c]));
+    }
+
+    // Кодирование идёт с конца: декодер читает слова в обратном порядке
+    vector<uint16_t> words;
+    words.reserve(size / 2 + 16);
+    uint32_t state[LANES] = {RANS_L, RANS_L, RANS_L, RANS_L};
+    {
+        StageTimer t(stats.encodeMs);
+        for (size_t i = size; i-- > 0;) {
+            uint32_t& x = state[i & (LANES - 1)];
+            uint32_t freq = freqs[data[i]];
+            // Порог в 64 битах: при freq == PROB_SCALE он равен 2^32
+            uint64_t xMax = (uint64_t(RANS_L >> PROB_BITS) << 16) * freq;
+            if (x >= xMax) {
+                words.push_back(static_cast<uint16_t>(x));
+                x >>= 16;
+            }
+            x = ((x / freq) << PROB_BITS) + (x % freq) + cums[data[i]];
+        }
+    }
+
+    for (uint32_t x : state) appendValue(out, x);
+    for (auto it = words.rbegin(); it != words.rend(); ++it) appendValue(out, *it);
+    out.insert(out.end(), PADDING_WORDS * 2, 0);
+
+    stats.symbols = size;
+    stats.payloadBytes = words.size() * 2 + sizeof(state);
+    recordStats(stats);
+}
+
+bool ransDecompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize) {
+    const uint8_t* pos = data;
+    const uint8_t* end = data + size;
+
+    if (pos == end) {
+        cerr << "Invalid rANS block\n";
+        return false;
+    }
+    uint8_t marker = *pos++;
+    if (marker == 'U') {
+        if (static_cast<size_t>(end - pos) != rawSize) {
+            cerr << "rANS block size does not match the frame\n";
+            return false;
+        }
+        out.insert(out.end(), pos, end);
+        return true;
+    }
+    if (marker != 'R') {
+        cerr << "Invalid rANS block\n";
+        return false;
+    }
+
+    uint32_t dataSize;
+    uint16_t used;
+    if (!readValue(pos, end, dataSize) || !readValue(pos, end, used) || used == 0 || used > 256) {
+        cerr << "Invalid rANS header\n";
+        return false;
+    }
+    // Результат выделяется по dataSize, поэтому он сверяется с кадром до всего остального
+    if (dataSize != rawSize) {
+        cerr << "rANS block size does not match the frame\n";
+        return false;
+    }
+
+    // Таблица декодирования: ячейка -> символ, частота, смещение
+    vector<DecodeSlot> table(PROB_SCALE);
+    uint32_t cum = 0;
+    for (uint16_t i = 0; i < used; ++i) {
+        uint8_t symbol;
+        uint16_t freq;
+        if (!readValue(pos, end, symbol) || !readValue(pos, end, freq) ||
+            freq == 0 || cum + freq > PROB_SCALE) {
+            cerr << "Invalid rANS frequency table\n";
+            return false;
+        }
+        for (uint32_t slot = cum; slot < cum + freq; ++slot) {
+            table[slot] = {freq, static_cast<uint16_t>(slot - cum), symbol};
+        }
+        cum += freq;
+    }
+    if (cum != PROB_SCALE) {
+        cerr << "Invalid rANS frequency table\n";
+        return false;
+    }
+
+    uint32_t state[LANES];
+    for (uint32_t& x : state) {
+        if (!readValue(pos, end, x)) {
+            cerr << "Truncated rANS block\n";
+            return false;
+        }
+    }
+    if (static_cast<size_t>(end - pos) < PADDING_WORDS * 2) {
+        cerr << "Truncated rANS block\n";
+        return false;
+    }
+    // Последние PADDING_WORDS слов — запас, настоящие слова заканчиваются раньше
+    const uint8_t* wordsStart = pos;
+    const uint8_t* wordsEnd = end - PADDING_WORDS * 2;
+
+    RansStats stats;
+    size_t base = out.size();
+    out.resize(base + dataSize);
+    uint8_t* dst = out.data() + base;
+
+    auto step = [&](uint32_t& x, size_t i) {
+        const DecodeSlot& slot = table[x & (PROB_SCALE - 1)];
+        dst[i] = slot.symbol;
+        x = slot.freq * (x >> PROB_BITS) + slot.offset;
+        // Перенормировка без ветвления: слово читается всегда, берётся по условию
+        uint32_t word = uint32_t(pos[0]) | (uint32_t(pos[1]) << 8);
+        uint32_t need = x < RANS_L;
+        x = need ? (x << 16) | word : x;
+        pos += need * 2;
+    };
+
+    {
+        StageTimer t(stats.decodeMs);
+        size_t i = 0;
+        for (; i + LANES <= dataSize; i += LANES) {
+            step(state[0], i);
+            step(state[1], i + 1);
+            step(state[2], i + 2);
+            step(state[3], i + 3);
+            if (pos > wordsEnd) break;
+        }
+        for (; i < dataSize && pos <= wordsEnd; ++i) {
+            step(state[i & (LANES - 1)], i);
+        }
+    }
+
+    // Кодер начинал со всех состояний RANS_L и ровно с этой позиции
+    bool ok = pos == wordsEnd;
+    for (uint32_t x : state) ok = ok && x == RANS_L;
+    if (!ok) {
+        cerr << "Corrupt rANS stream\n";
+        out.resize(base);
+        return false;
+    }
+
+    stats.symbols = dataSize;
+    stats.payloadBytes = static_cast<uint64_t>(wordsEnd - wordsStart) + sizeof(state);
+    recordStats(stats);
+    return true;
+}
+
+// Словарь не используется: таблица частот строится по каждому блоку
+class RansCodec : public Codec {
+public:
+    CodecId id() const override { return CodecId::Rans; }
+    const char* name() const override { return "rANS"; }
+
+    void compress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                  const CodecParams&, CodecContext*) const override {
+        ransCompress(data, size, out);
+    }
+
+    bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize,
+                    const CodecParams&) const override {
+        return ransDecompress(data, size, out, rawSize);
+    }
+
+    // Поток слов, результат и таблицы частот
+    size_t workingMemory(size_t blockSize) const override {
+        return 4 * blockSize + (size_t(64) << 10);
+    }
+};
+
+static CodecRegistration<RansCodec> registerRans;
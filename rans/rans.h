@@ -0,0 +1,14 @@
+// rans.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатие блока асимметричными системами счисления (rANS, 4 чередующихся
+// состояния). Гистограмма нормализуется к таблице из 4096 ячеек, поэтому
+// символ стоит дробное число бит. Результат дописывается в конец out.
+void ransCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+// Распаковка блока ровно в rawSize байт, дописываемых в out; блок с
+// другим размером отвергается до выделения памяти. false — повреждённые данные
+bool ransDecompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t rawSize);
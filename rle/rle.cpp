@@ -5,8 +5,118 @@
 #include <iomanip>
 #include <cstdint>
 
+#include "rle.h"
+#include "../codec/codec.h"
+#include "../stats/stats.h"
+
 using namespace std;
 
+// Ядро RLE, параметризованное шириной управляющего слова пакета.
+// Старший бит слова — признак повтора, остальные биты — длина повтора
+// (2..MAX_RUN) или длина литерала минус один (1..MAX_LITERAL байт). Границы
+// известны при компиляции, поэтому циклы поиска не читают их из памяти.
+template <typename Control>
+struct RLEKernel {
+    static constexpr size_t CONTROL_BYTES = sizeof(Control);
+    static constexpr size_t RUN_FLAG = size_t(1) << (CONTROL_BYTES * 8 - 1);
+    static constexpr size_t MAX_RUN = RUN_FLAG - 1;
+    static constexpr size_t MAX_LITERAL = RUN_FLAG;
+
+    static_assert(CONTROL_BYTES == 1 || CONTROL_BYTES == 2, "control word is 8 or 16 bits");
+
+    static void putControl(vector<uint8_t>& out, size_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        if constexpr (CONTROL_BYTES == 2) out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    static size_t getControl(const uint8_t* p) {
+        size_t value = p[0];
+        if constexpr (CONTROL_BYTES == 2) value |= size_t(p[1]) << 8;
+        return value;
+    }
+
+    static void compress(const uint8_t* buffer, size_t size, vector<uint8_t>& output) {
+        RLEStats stats;
+        output.reserve(output.size() + size + (size / MAX_LITERAL + 1) * CONTROL_BYTES);
+
+        size_t i = 0;
+        while (i < size) {
+            size_t runLength = 1;
+
+            while (i + runLength < size && buffer[i] == buffer[i + runLength] && runLength < MAX_RUN)
+                ++runLength;
+
+            if (runLength >= 2) {
+                putControl(output, RUN_FLAG + runLength);
+                output.push_back(buffer[i]);
+                ++stats.runPackets;
+                stats.runBytes += runLength;
+                ++stats.runLengths[RLEStats::bucket(runLength)];
+                i += runLength;
+            } else {
+                size_t rawStart = i;
+                size_t rawLen = 0;
+                while ((i + rawLen < size) &&
+                       (rawLen < MAX_LITERAL) &&
+                       !(i + rawLen + 1 < size &&
+                         buffer[i + rawLen] == buffer[i + rawLen + 1])) {
+                    ++rawLen;
+                }
+
+                putControl(output, rawLen - 1);
+                output.insert(output.end(), buffer + rawStart, buffer + rawStart + rawLen);
+                ++stats.literalPackets;
+                stats.literalBytes += rawLen;
+                ++stats.literalLengths[RLEStats::bucket(rawLen)];
+                i += rawLen;
+            }
+        }
+
+        recordStats(stats);
+    }
+
+    // Пакет, выходящий за rawSize, отвергается до записи: серия из трёх
+    // байт разворачивается до MAX_RUN байт
+    static bool decompress(const uint8_t* input, size_t size, vector<uint8_t>& output,
+                           size_t rawSize) {
+        const size_t base = output.size();
+        size_t room = rawSize;
+        size_t i = 0;
+        while (i < size) {
+            if (size - i < CONTROL_BYTES) return false;
+            size_t control = getControl(input + i);
+            i += CONTROL_BYTES;
+
+            if (control >= RUN_FLAG) {
+                size_t count = control - RUN_FLAG;
+                if (i >= size || count > room) return false;
+                output.insert(output.end(), count, input[i++]);
+                room -= count;
+            } else {
+                size_t count = control + 1;
+                if (size - i < count || count > room) return false;
+                output.insert(output.end(), input + i, input + i + count);
+                i += count;
+                room -= count;
+            }
+        }
+        return rawSize == CODEC_UNKNOWN_SIZE || output.size() - base == rawSize;
+    }
+};
+
+// Пресеты: байтовые пакеты (исходный формат) и 16-битные для длинных
+// серий в разреженных данных
+using RLEByte = RLEKernel<uint8_t>;
+using RLEWide = RLEKernel<uint16_t>;
+
+void rleCompress(const uint8_t* buffer, size_t size, vector<uint8_t>& output) {
+    RLEByte::compress(buffer, size, output);
+}
+
+bool rleDecompress(const uint8_t* input, size_t size, vector<uint8_t>& output, size_t rawSize) {
+    return RLEByte::decompress(input, size, output, rawSize);
+}
+
 void compressFileRLE(const string& inputPath, const string& outputPath) {
     ifstream input(inputPath, ios::binary);
     ofstream output(outputPath, ios::binary);
@@ -16,47 +126,35 @@ void compressFileRLE(const string& inputPath, const string& outputPath) {
         return;
     }
 
+    IOStats io;
+
     const size_t BUFFER_SIZE = 1 << 20;
     vector<unsigned char> buffer(BUFFER_SIZE);
-    input.read(reinterpret_cast<char*>(buffer.data()), BUFFER_SIZE);
-    size_t bytesRead = input.gcount();
-
-    size_t i = 0;
-    while (i < bytesRead) {
-        size_t runStart = i;
-        size_t runLength = 1;
-
-        while (i + runLength < bytesRead && buffer[i] == buffer[i + runLength] && runLength < 127)
-            ++runLength;
-
-        if (runLength >= 2) {
-            output.put(static_cast<unsigned char>(0x80 + runLength));
-            output.put(buffer[i]);
-            i += runLength;
-        } else {
-            size_t rawStart = i;
-            size_t rawLen = 0;
-            while ((i + rawLen < bytesRead) &&
-                   (rawLen < 128) &&
-                   !(i + rawLen + 1 < bytesRead &&
-                     buffer[i + rawLen] == buffer[i + rawLen + 1])) {
-                ++rawLen;
-            }
-
-            output.put(static_cast<unsigned char>(rawLen - 1));
-            output.write(reinterpret_cast<char*>(&buffer[rawStart]), rawLen);
-            i += rawLen;
-        }
-
-        if (i >= bytesRead && input) {
+    vector<uint8_t> packed;
+    while (input) {
+        {
+            StageTimer t(io.readMs);
             input.read(reinterpret_cast<char*>(buffer.data()), BUFFER_SIZE);
-            bytesRead = input.gcount();
-            i = 0;
         }
+        size_t bytesRead = input.gcount();
+        if (bytesRead == 0) break;
+        io.bytesRead += bytesRead;
+
+        packed.clear();
+        rleCompress(buffer.data(), bytesRead, packed);
+        {
+            StageTimer t(io.writeMs);
+            output.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+        }
+        io.bytesWritten += packed.size();
     }
 
+    {
+        StageTimer t(io.writeMs);
+        output.close();
+    }
     input.close();
-    output.close();
+    recordStats(io);
 }
 
 
@@ -69,25 +167,60 @@ void decompressFileRLE(const string& inputPath, const string& outputPath) {
         return;
     }
 
-    while (true) {
-        int control = input.get();
-        if (control == EOF) break;
-
-        if (control >= 0x80) {
-            int count = control - 0x80;
-            int value = input.get();
-            if (value == EOF) break;
-
-            for (int i = 0; i < count; ++i)
-                output.put(static_cast<unsigned char>(value));
-        } else {
-            int count = control + 1;
-            vector<char> raw(count);
-            input.read(raw.data(), count);
-            output.write(raw.data(), input.gcount());
-        }
+    IOStats io;
+    vector<uint8_t> packed;
+    {
+        StageTimer t(io.readMs);
+        packed.assign(istreambuf_iterator<char>(input), {});
+    }
+    io.bytesRead = packed.size();
+
+    vector<uint8_t> data;
+    if (!rleDecompress(packed.data(), packed.size(), data)) {
+        cerr << "Truncated RLE packet" << endl;
     }
 
+    {
+        StageTimer t(io.writeMs);
+        output.write(reinterpret_cast<const char*>(data.data()), data.size());
+        output.close();
+    }
+    io.bytesWritten = data.size();
     input.close();
-    output.close();
+    recordStats(io);
 }
+
+template <typename Kernel, CodecId Id>
+class RLECodec : public Codec {
+    const char* name_;
+
+public:
+    explicit RLECodec(const char* name) : name_(name) {}
+
+    CodecId id() const override { return Id; }
+    const char* name() const override { return name_; }
+
+    void compress(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                  const CodecParams&, CodecContext*) const override {
+        Kernel::compress(data, size, out);
+    }
+
+    bool decompress(const uint8_t* data, size_t size, vector<uint8_t>& out, size_t rawSize,
+                    const CodecParams&) const override {
+        return Kernel::decompress(data, size, out, rawSize);
+    }
+
+    // Результат может вырасти при перевыделении вдвое
+    size_t workingMemory(size_t blockSize) const override { return 3 * blockSize; }
+};
+
+struct RLEByteCodec : RLECodec<RLEByte, CodecId::RLE> {
+    RLEByteCodec() : RLECodec("RLE") {}
+};
+
+struct RLEWideCodec : RLECodec<RLEWide, CodecId::RLE16> {
+    RLEWideCodec() : RLECodec("RLE16") {}
+};
+
+static CodecRegistration<RLEByteCodec> registerRLE;
+static CodecRegistration<RLEWideCodec> registerRLE16;
@@ -0,0 +1,19 @@
+// rle.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../codec/codec.h"
+
+// Сжатие блока в памяти; формат совпадает с файлом compressFileRLE.
+// Результат дописывается в конец out.
+void rleCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+// Распаковка блока; false — оборванный пакет или результат не rawSize байт
+bool rleDecompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                   size_t rawSize = CODEC_UNKNOWN_SIZE);
+
+void compressFileRLE(const std::string& inputPath, const std::string& outputPath);
+void decompressFileRLE(const std::string& inputPath, const std::string& outputPath);
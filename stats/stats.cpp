@@ -0,0 +1,382 @@
+// stats.cpp
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+atomic<bool> g_enabled{false};
+atomic<bool> g_hwEnabled{false};
+mutex g_mutex;
+CodecStats g_stats;
+}
+
+LZ77Stats& LZ77Stats::operator+=(const LZ77Stats& o) {
+    positions += o.positions;
+    probes += o.probes;
+    literals += o.literals;
+    matches += o.matches;
+    matchBytes += o.matchBytes;
+    parseMs += o.parseMs;
+    return *this;
+}
+
+HuffmanStats& HuffmanStats::operator+=(const HuffmanStats& o) {
+    symbols += o.symbols;
+    bits += o.bits;
+    histogramMs += o.histogramMs;
+    treeMs += o.treeMs;
+    encodeMs += o.encodeMs;
+    decodeMs += o.decodeMs;
+    segments += o.segments;
+    tables += o.tables;
+    return *this;
+}
+
+RansStats& RansStats::operator+=(const RansStats& o) {
+    symbols += o.symbols;
+    payloadBytes += o.payloadBytes;
+    histogramMs += o.histogramMs;
+    normalizeMs += o.normalizeMs;
+    encodeMs += o.encodeMs;
+    decodeMs += o.decodeMs;
+    return *this;
+}
+
+BWTStats& BWTStats::operator+=(const BWTStats& o) {
+    bytes += o.bytes;
+    symbols += o.symbols;
+    zeroRuns += o.zeroRuns;
+    sortMs += o.sortMs;
+    mtfMs += o.mtfMs;
+    inverseMs += o.inverseMs;
+    return *this;
+}
+
+RLEStats& RLEStats::operator+=(const RLEStats& o) {
+    runPackets += o.runPackets;
+    literalPackets += o.literalPackets;
+    runBytes += o.runBytes;
+    literalBytes += o.literalBytes;
+    for (size_t i = 0; i < RLE_LENGTH_BUCKETS; ++i) {
+        runLengths[i] += o.runLengths[i];
+        literalLengths[i] += o.literalLengths[i];
+    }
+    return *this;
+}
+
+DedupStats& DedupStats::operator+=(const DedupStats& o) {
+    chunks += o.chunks;
+    duplicates += o.duplicates;
+    bytes += o.bytes;
+    duplicateBytes += o.duplicateBytes;
+    chunkMs += o.chunkMs;
+    indexMs += o.indexMs;
+    return *this;
+}
+
+IOStats& IOStats::operator+=(const IOStats& o) {
+    bytesRead += o.bytesRead;
+    bytesWritten += o.bytesWritten;
+    readMs += o.readMs;
+    writeMs += o.writeMs;
+    return *this;
+}
+
+// Пики параллельных замеров не складываются
+MemoryStats& MemoryStats::operator+=(const MemoryStats& o) {
+    peakBytes = max(peakBytes, o.peakBytes);
+    return *this;
+}
+
+HardwareStats& HardwareStats::operator+=(const HardwareStats& o) {
+    if (!o.valid) return *this;
+    valid = true;
+    cycles += o.cycles;
+    instructions += o.instructions;
+    cacheMisses += o.cacheMisses;
+    return *this;
+}
+
+CodecStats& CodecStats::operator+=(const CodecStats& o) {
+    lz77 += o.lz77;
+    huffman += o.huffman;
+    rans += o.rans;
+    bwt += o.bwt;
+    rle += o.rle;
+    dedup += o.dedup;
+    io += o.io;
+    memory += o.memory;
+    hw += o.hw;
+    return *this;
+}
+
+void setStatsEnabled(bool enabled) { g_enabled.store(enabled, memory_order_relaxed); }
+bool statsEnabled() { return g_enabled.load(memory_order_relaxed); }
+void setHardwareCountersEnabled(bool enabled) { g_hwEnabled.store(enabled, memory_order_relaxed); }
+bool hardwareCountersEnabled() { return g_hwEnabled.load(memory_order_relaxed); }
+
+void resetStats() {
+    lock_guard<mutex> lock(g_mutex);
+    g_stats = CodecStats();
+}
+
+CodecStats snapshotStats() {
+    lock_guard<mutex> lock(g_mutex);
+    return g_stats;
+}
+
+void recordStats(const LZ77Stats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.lz77 += s;
+}
+
+void recordStats(const HuffmanStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.huffman += s;
+}
+
+void recordStats(const RansStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.rans += s;
+}
+
+void recordStats(const BWTStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.bwt += s;
+}
+
+void recordStats(const RLEStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.rle += s;
+}
+
+void recordStats(const DedupStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.dedup += s;
+}
+
+void recordStats(const IOStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.io += s;
+}
+
+void recordStats(const HardwareStats& s) {
+    if (!statsEnabled()) return;
+    lock_guard<mutex> lock(g_mutex);
+    g_stats.hw += s;
+}
+
+#ifdef __linux__
+static int openCounter(uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Потоки пула создаются позже и наследуют счётчик: с -T N и в
+    // пакетном режиме работа кодеков идёт именно в них
+    attr.inherit = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+PerfCounters::PerfCounters() {
+#ifdef __linux__
+    if (!hardwareCountersEnabled()) return;
+    const uint64_t configs[3] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < 3; ++i) {
+        fds_[i] = openCounter(configs[i]);
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds_) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int fd : fds_) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    running_ = true;
+#endif
+}
+
+HardwareStats PerfCounters::stop() {
+    HardwareStats hw;
+#ifdef __linux__
+    if (!running_) return hw;
+    running_ = false;
+
+    uint64_t values[3] = {0, 0, 0};
+    bool any = false;
+    for (int i = 0; i < 3; ++i) {
+        if (fds_[i] < 0) continue;
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fds_[i], &values[i], sizeof(values[i])) == sizeof(values[i])) {
+            any = true;
+        }
+    }
+    hw.valid = any;
+    hw.cycles = values[0];
+    hw.instructions = values[1];
+    hw.cacheMisses = values[2];
+#endif
+    return hw;
+}
+
+// Корзины гистограммы длин пакетов: 1, 2-3, 4-7, ..., 128-255; дальше
+// только непустые (широкие пакеты RLE16)
+static void printLengthBuckets(ostream& out, const char* name,
+                               const uint64_t (&buckets)[RLE_LENGTH_BUCKETS]) {
+    out << "  " << name << ":";
+    for (size_t b = 0; b < RLE_LENGTH_BUCKETS; ++b) {
+        if (b > 7 && buckets[b] == 0) continue;
+        size_t lo = size_t(1) << b;
+        size_t hi = lo * 2 - 1;
+        out << " [" << lo;
+        if (hi != lo) out << "-" << hi;
+        out << "]=" << buckets[b];
+    }
+    out << "\n";
+}
+
+void printStatsReport(ostream& out, const string& title, const CodecStats& s) {
+    out << fixed << setprecision(3);
+    out << "[stats " << title << "]\n";
+
+    const LZ77Stats& lz = s.lz77;
+    if (lz.positions > 0) {
+        uint64_t tokens = lz.literals + lz.matches;
+        out << "lz77:\n"
+            << "  parse_ms: " << lz.parseMs << "\n"
+            << "  positions: " << lz.positions << "\n"
+            << "  probes_per_position: "
+            << static_cast<double>(lz.probes) / lz.positions << "\n"
+            << "  literals: " << lz.literals << "\n"
+            << "  matches: " << lz.matches << "\n"
+            << "  match_share: "
+            << (tokens ? static_cast<double>(lz.matches) / tokens : 0.0) << "\n"
+            << "  avg_match_len: "
+            << (lz.matches ? static_cast<double>(lz.matchBytes) / lz.matches : 0.0) << "\n";
+    }
+
+    const HuffmanStats& hf = s.huffman;
+    if (hf.symbols > 0) {
+        out << "huffman:\n"
+            << "  histogram_ms: " << hf.histogramMs << "\n"
+            << "  tree_ms: " << hf.treeMs << "\n"
+            << "  encode_ms: " << hf.encodeMs << "\n"
+            << "  decode_ms: " << hf.decodeMs << "\n"
+            << "  symbols: " << hf.symbols << "\n"
+            << "  avg_code_len_bits: "
+            << static_cast<double>(hf.bits) / hf.symbols << "\n";
+        if (hf.segments > 0) {
+            out << "  segments: " << hf.segments << "\n"
+                << "  table_switches: " << hf.tables << "\n";
+        }
+    }
+
+    const RansStats& ra = s.rans;
+    if (ra.symbols > 0) {
+        out << "rans:\n"
+            << "  histogram_ms: " << ra.histogramMs << "\n"
+            << "  normalize_ms: " << ra.normalizeMs << "\n"
+            << "  encode_ms: " << ra.encodeMs << "\n"
+            << "  decode_ms: " << ra.decodeMs << "\n"
+            << "  symbols: " << ra.symbols << "\n"
+            << "  bits_per_symbol: "
+            << static_cast<double>(ra.payloadBytes) * 8 / ra.symbols << "\n";
+    }
+
+    const BWTStats& bw = s.bwt;
+    if (bw.bytes > 0) {
+        out << "bwt:\n"
+            << "  sort_ms: " << bw.sortMs << "\n"
+            << "  mtf_ms: " << bw.mtfMs << "\n"
+            << "  inverse_ms: " << bw.inverseMs << "\n"
+            << "  bytes: " << bw.bytes << "\n"
+            << "  zero_runs: " << bw.zeroRuns << "\n"
+            << "  symbols_per_byte: "
+            << static_cast<double>(bw.symbols) / bw.bytes << "\n";
+    }
+
+    const RLEStats& rl = s.rle;
+    if (rl.runPackets + rl.literalPackets > 0) {
+        out << "rle:\n"
+            << "  run_packets: " << rl.runPackets << "\n"
+            << "  run_bytes: " << rl.runBytes << "\n"
+            << "  literal_packets: " << rl.literalPackets << "\n"
+            << "  literal_bytes: " << rl.literalBytes << "\n";
+        printLengthBuckets(out, "run_lengths", rl.runLengths);
+        printLengthBuckets(out, "literal_lengths", rl.literalLengths);
+    }
+
+    const DedupStats& dd = s.dedup;
+    if (dd.chunks > 0) {
+        out << "dedup:\n"
+            << "  chunk_ms: " << dd.chunkMs << "\n"
+            << "  index_ms: " << dd.indexMs << "\n"
+            << "  chunks: " << dd.chunks << "\n"
+            << "  duplicate_chunks: " << dd.duplicates << "\n"
+            << "  avg_chunk_bytes: " << static_cast<double>(dd.bytes) / dd.chunks << "\n"
+            << "  duplicate_share: "
+            << (dd.bytes ? static_cast<double>(dd.duplicateBytes) / dd.bytes : 0.0) << "\n";
+    }
+
+    out << "io:\n"
+        << "  bytes_read: " << s.io.bytesRead << "\n"
+        << "  bytes_written: " << s.io.bytesWritten << "\n"
+        << "  read_ms: " << s.io.readMs << "\n"
+        << "  write_ms: " << s.io.writeMs << "\n";
+
+    if (s.memory.peakBytes > 0) {
+        out << "memory:\n"
+            << "  peak_bytes: " << s.memory.peakBytes << "\n";
+    }
+
+    if (s.hw.valid) {
+        out << "hw:\n"
+            << "  cycles: " << s.hw.cycles << "\n"
+            << "  instructions: " << s.hw.instructions << "\n"
+            << "  ipc: "
+            << (s.hw.cycles ? static_cast<double>(s.hw.instructions) / s.hw.cycles : 0.0) << "\n"
+            << "  cache_misses: " << s.hw.cacheMisses << "\n";
+    } else if (hardwareCountersEnabled()) {
+        out << "hw:\n  unavailable: perf_event_open failed\n";
+    }
+}
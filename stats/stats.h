@@ -0,0 +1,199 @@
+// stats.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Счётчики LZ77: поиск совпадений и состав выходного потока
+struct LZ77Stats {
+    uint64_t positions = 0;   // Позиции, для которых выполнялся поиск
+    uint64_t probes = 0;      // Проверенные кандидаты в окне
+    uint64_t literals = 0;    // Токены без совпадения
+    uint64_t matches = 0;     // Токены с совпадением
+    uint64_t matchBytes = 0;  // Байты, покрытые совпадениями
+    double parseMs = 0;       // Время разбора (поиск совпадений и запись токенов)
+
+    LZ77Stats& operator+=(const LZ77Stats& o);
+};
+
+// Счётчики Хаффмана по стадиям
+struct HuffmanStats {
+    uint64_t symbols = 0;     // Закодированные/декодированные символы
+    uint64_t bits = 0;        // Биты полезной нагрузки
+    double histogramMs = 0;
+    double treeMs = 0;
+    double encodeMs = 0;
+    double decodeMs = 0;
+    uint64_t segments = 0;    // Сегменты потокового режима (encode)
+    uint64_t tables = 0;      // Из них с новой таблицей
+
+    HuffmanStats& operator+=(const HuffmanStats& o);
+};
+
+// Счётчики rANS по стадиям
+struct RansStats {
+    uint64_t symbols = 0;
+    uint64_t payloadBytes = 0;  // Поток слов без таблицы частот
+    double histogramMs = 0;
+    double normalizeMs = 0;
+    double encodeMs = 0;
+    double decodeMs = 0;
+
+    RansStats& operator+=(const RansStats& o);
+};
+
+// Счётчики блочной сортировки (BWT + MTF + серии нулей)
+struct BWTStats {
+    uint64_t bytes = 0;        // Байты блоков
+    uint64_t symbols = 0;      // Символы после кодирования серий нулей
+    uint64_t zeroRuns = 0;     // Серии нулевых рангов MTF
+    double sortMs = 0;         // Суффиксный массив (SA-IS)
+    double mtfMs = 0;          // MTF и серии нулей (в обе стороны)
+    double inverseMs = 0;      // Обратное преобразование
+
+    BWTStats& operator+=(const BWTStats& o);
+};
+
+const size_t RLE_LENGTH_BUCKETS = 17;
+
+// Распределение пакетов RLE по длинам: корзина i — длины [2^i, 2^(i+1))
+struct RLEStats {
+    uint64_t runPackets = 0;
+    uint64_t literalPackets = 0;
+    uint64_t runBytes = 0;
+    uint64_t literalBytes = 0;
+    uint64_t runLengths[RLE_LENGTH_BUCKETS] = {};
+    uint64_t literalLengths[RLE_LENGTH_BUCKETS] = {};
+
+    static size_t bucket(size_t length) {
+        size_t b = 0;
+        while (length > 1 && b + 1 < RLE_LENGTH_BUCKETS) {
+            length >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+    RLEStats& operator+=(const RLEStats& o);
+};
+
+// Дедупликация фрагментов перед кодеком
+struct DedupStats {
+    uint64_t chunks = 0;          // Все фрагменты
+    uint64_t duplicates = 0;      // Заменены ссылками
+    uint64_t bytes = 0;           // Байты до дедупликации
+    uint64_t duplicateBytes = 0;  // Байты, не переданные кодеку
+    double chunkMs = 0;           // Разбиение и отпечатки
+    double indexMs = 0;           // Поиск в индексе и история
+
+    DedupStats& operator+=(const DedupStats& o);
+};
+
+// Время ожидания ввода-вывода
+struct IOStats {
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    double readMs = 0;
+    double writeMs = 0;
+
+    IOStats& operator+=(const IOStats& o);
+};
+
+// Пик кучи за замер (учёт в memory/memory.cpp)
+struct MemoryStats {
+    uint64_t peakBytes = 0;
+
+    MemoryStats& operator+=(const MemoryStats& o);
+};
+
+// Аппаратные счётчики (perf_event_open)
+struct HardwareStats {
+    bool valid = false;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+
+    HardwareStats& operator+=(const HardwareStats& o);
+};
+
+struct CodecStats {
+    LZ77Stats lz77;
+    HuffmanStats huffman;
+    RansStats rans;
+    BWTStats bwt;
+    RLEStats rle;
+    DedupStats dedup;
+    IOStats io;
+    MemoryStats memory;
+    HardwareStats hw;
+
+    CodecStats& operator+=(const CodecStats& o);
+};
+
+// Глобальный сбор статистики. Кодеки копят счётчики в локальных
+// структурах и сливают их одним вызовом record*() в конце работы,
+// поэтому горячие циклы не трогают общих данных.
+void setStatsEnabled(bool enabled);
+bool statsEnabled();
+void setHardwareCountersEnabled(bool enabled);
+bool hardwareCountersEnabled();
+
+void resetStats();
+CodecStats snapshotStats();
+
+void recordStats(const LZ77Stats& s);
+void recordStats(const HuffmanStats& s);
+void recordStats(const RansStats& s);
+void recordStats(const BWTStats& s);
+void recordStats(const RLEStats& s);
+void recordStats(const DedupStats& s);
+void recordStats(const IOStats& s);
+void recordStats(const HardwareStats& s);
+
+// Таймер стадии: прибавляет прошедшее время к accumulator (в мс).
+// При выключенной статистике часы не опрашиваются.
+class StageTimer {
+    double& accumulator_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    explicit StageTimer(double& accumulator)
+        : accumulator_(accumulator), active_(statsEnabled()) {
+        if (active_) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~StageTimer() {
+        if (active_) {
+            accumulator_ += std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start_).count();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+};
+
+// Группа аппаратных счётчиков текущего потока и потоков, созданных им
+// после конструктора (пул WorkerPool): cycles, instructions,
+// cache-misses. Вне Linux или без прав на perf_event_open valid == false.
+class PerfCounters {
+    int fds_[3] = {-1, -1, -1};
+    bool running_ = false;
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    void start();
+    HardwareStats stop();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+};
+
+// Структурированный отчёт: секции и пары "ключ: значение"
+void printStatsReport(std::ostream& out, const std::string& title, const CodecStats& stats);
@@ -0,0 +1,581 @@
+// stream.cpp
+#include "stream.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "../stats/stats.h"
+
+using namespace std;
+
+// Заголовок: "CFZ" + версия, кодек, уровень, 2 байта флагов, размер блока
+static const uint8_t MAGIC[4] = {'C', 'F', 'Z', 1};
+static const size_t HEADER_SIZE = STREAM_HEADER_SIZE;
+// Кадр: исходный размер, размер полезной нагрузки (старший бит — блок без сжатия)
+static const size_t FRAME_HEADER_SIZE = 8;
+static const uint32_t STORED_FLAG = 0x80000000u;
+// Флаги заголовка: за ним следует id словаря (4 байта), затем
+// история дедупликации в КиБ (4 байта)
+static const uint8_t FLAG_DICTIONARY = 0x01;
+static const uint8_t FLAG_DEDUP = 0x02;
+static const size_t MAX_BLOCK_SIZE = size_t(64) << 20;
+// Заголовки, буферы iostream и пул, не зависящие от размера блока
+static const size_t STREAM_OVERHEAD = size_t(256) << 10;
+
+const Codec& findCodec(CodecId id) {
+    const Codec* codec = CodecRegistry::instance().find(id);
+    if (!codec) {
+        throw runtime_error("unknown codec id " + to_string(static_cast<unsigned>(id)));
+    }
+    return *codec;
+}
+
+size_t streamMemory(const Codec& codec, unsigned threads, size_t blockSize, size_t dedupHistory) {
+    // Исходный блок, сжатый кадр и рабочая память кодека на каждый поток
+    size_t perThread = 2 * blockSize + codec.workingMemory(blockSize);
+    size_t shared = STREAM_OVERHEAD;
+    if (dedupHistory > 0) {
+        perThread += blockSize;
+        shared += dedupMemory(dedupHistory);
+    }
+    return max(1u, threads) * perThread + shared;
+}
+
+static string memoryLimitError(const Codec& codec, size_t limit, size_t blockSize,
+                               size_t dedupHistory) {
+    string error = "memory limit of " + to_string(limit) + " bytes is too small: " +
+                   codec.name() + " needs " +
+                   to_string(streamMemory(codec, 1, blockSize, dedupHistory)) + " bytes with " +
+                   to_string(blockSize) + " byte blocks";
+    if (dedupHistory > 0) error += " and " + to_string(dedupHistory) + " bytes of dedup history";
+    return error;
+}
+
+StreamOptions fitMemoryLimit(const StreamOptions& options) {
+    StreamOptions plan = options;
+    plan.threads = max(1u, plan.threads);
+    if (plan.memoryLimit == 0) return plan;
+
+    const Codec& codec = findCodec(plan.codec);
+    auto history = [&] { return plan.dedup ? plan.dedupHistory : 0; };
+    auto fits = [&] {
+        return streamMemory(codec, plan.threads, plan.blockSize, history()) <= plan.memoryLimit;
+    };
+
+    // История обычно самая крупная статья и теряет лишь дальние повторы.
+    // Блок меньше — чуть хуже сжатие; поток меньше — вдвое медленнее,
+    // поэтому сначала блок до разумного минимума, потом потоки
+    while (!fits() && plan.dedup && plan.dedupHistory / 2 >= DEDUP_MIN_HISTORY) {
+        plan.dedupHistory /= 2;
+    }
+    while (!fits() && plan.blockSize / 2 >= STREAM_PREFERRED_MIN_BLOCK_SIZE) plan.blockSize /= 2;
+    while (!fits() && plan.threads > 1) --plan.threads;
+    while (!fits() && plan.blockSize / 2 >= STREAM_MIN_BLOCK_SIZE) plan.blockSize /= 2;
+    if (!fits()) {
+        throw runtime_error(memoryLimitError(codec, plan.memoryLimit, plan.blockSize, history()));
+    }
+    return plan;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// Читает до size байт; меньше — только в конце потока
+static size_t readFully(istream& in, uint8_t* data, size_t size, IOStats& io) {
+    StageTimer t(io.readMs);
+    in.read(reinterpret_cast<char*>(data), size);
+    size_t got = static_cast<size_t>(in.gcount());
+    if (in.bad()) throw runtime_error("read error");
+    io.bytesRead += got;
+    return got;
+}
+
+static void writeAll(ostream& out, const uint8_t* data, size_t size, IOStats& io) {
+    StageTimer t(io.writeMs);
+    out.write(reinterpret_cast<const char*>(data), size);
+    if (!out) throw runtime_error("write error");
+    io.bytesWritten += size;
+}
+
+// Выполняет job(i, worker) для i < count: в вызывающем потоке или в пуле
+template <typename Job>
+static void runBatch(size_t count, WorkerPool* pool, Job job) {
+    if (count <= 1 || !pool) {
+        for (size_t i = 0; i < count; ++i) job(i, 0u);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        pool->submit([&job, i](unsigned worker) { job(i, worker); });
+    }
+    pool->wait();
+}
+
+static void checkOptions(const StreamOptions& options) {
+    if (options.blockSize == 0 || options.blockSize > MAX_BLOCK_SIZE) {
+        throw runtime_error("block size must be between 1 byte and 64 MiB");
+    }
+    if (options.dedup && (options.dedupHistory < DEDUP_MAX_CHUNK ||
+                          (options.dedupHistory >> 10) > UINT32_MAX)) {
+        throw runtime_error("dedup history must be between 64 KiB and 4 TiB");
+    }
+}
+
+// Словарь, с которым сжимаются кадры: кодек, который его не читает,
+// не должен и требовать его при распаковке
+static const Dictionary* streamDictionary(const Codec& codec, const StreamOptions& options) {
+    return codec.usesDictionary() ? options.dictionary : nullptr;
+}
+
+static void makeHeader(const Codec& codec, const StreamOptions& options, vector<uint8_t>& header) {
+    const Dictionary* dict = streamDictionary(codec, options);
+    header.assign(HEADER_SIZE, 0);
+    copy(MAGIC, MAGIC + 4, header.begin());
+    header[4] = static_cast<uint8_t>(options.codec);
+    header[5] = static_cast<uint8_t>(options.level);
+    header[6] = (dict ? FLAG_DICTIONARY : 0) | (options.dedup ? FLAG_DEDUP : 0);
+    putU32(header.data() + 8, static_cast<uint32_t>(options.blockSize));
+    if (dict) {
+        header.resize(header.size() + 4);
+        putU32(header.data() + header.size() - 4, dict->id);
+    }
+    if (options.dedup) {
+        header.resize(header.size() + 4);
+        putU32(header.data() + header.size() - 4,
+               static_cast<uint32_t>(options.dedupHistory >> 10));
+    }
+}
+
+struct StreamHeader {
+    const Codec* codec;
+    size_t blockSize;
+    bool hasDictionary;
+    bool hasDedup;
+    size_t dedupHistory; // Известна после parseHeaderExtras
+};
+
+// Проверяет первые HEADER_SIZE байт; за ними могут идти
+// необязательные поля (headerExtraSize байт)
+static StreamHeader parseHeader(const uint8_t* header) {
+    if (!equal(MAGIC, MAGIC + 4, header)) {
+        throw runtime_error("not a compressed stream (bad magic)");
+    }
+    StreamHeader h;
+    h.codec = &findCodec(static_cast<CodecId>(header[4]));
+    h.blockSize = getU32(header + 8);
+    if (h.blockSize == 0 || h.blockSize > MAX_BLOCK_SIZE) {
+        throw runtime_error("invalid block size in header");
+    }
+    h.hasDictionary = (header[6] & FLAG_DICTIONARY) != 0;
+    h.hasDedup = (header[6] & FLAG_DEDUP) != 0;
+    h.dedupHistory = 0;
+    return h;
+}
+
+static size_t headerExtraSize(const StreamHeader& h) {
+    return (h.hasDictionary ? 4 : 0) + (h.hasDedup ? 4 : 0);
+}
+
+// Словарь, с которым надо распаковывать поток, или nullptr
+static const Dictionary* matchDictionary(const StreamHeader& h, const uint8_t* idBytes,
+                                         const Dictionary* dict) {
+    if (!h.hasDictionary) return nullptr;
+    uint32_t id = getU32(idBytes);
+    if (!dict) {
+        throw runtime_error("stream needs dictionary " + to_string(id) + " (-D)");
+    }
+    if (dict->id != id) {
+        throw runtime_error("dictionary mismatch: stream needs " + to_string(id) +
+                            ", got " + to_string(dict->id));
+    }
+    return dict;
+}
+
+static size_t parseDedupHistory(const uint8_t* kibBytes) {
+    uint32_t kib = getU32(kibBytes);
+    if (kib == 0) throw runtime_error("invalid dedup history in header");
+    return size_t(kib) << 10;
+}
+
+// Разбирает необязательные поля заголовка; возвращает словарь для распаковки
+static const Dictionary* parseHeaderExtras(StreamHeader& h, const uint8_t* extras,
+                                           const Dictionary* dict) {
+    dict = matchDictionary(h, extras, dict);
+    if (h.hasDedup) h.dedupHistory = parseDedupHistory(extras + (h.hasDictionary ? 4 : 0));
+    return dict;
+}
+
+StreamInfo readStreamInfo(const uint8_t* header, size_t size) {
+    if (size < HEADER_SIZE) throw runtime_error("not a compressed stream (bad magic)");
+    StreamHeader h = parseHeader(header);
+    if (size - HEADER_SIZE < headerExtraSize(h)) throw runtime_error("truncated header");
+    // Словарь здесь не сверяется: нужна только оценка памяти
+    size_t history = 0;
+    if (h.hasDedup) history = parseDedupHistory(header + HEADER_SIZE + (h.hasDictionary ? 4 : 0));
+    return {h.codec->id(), h.blockSize, history};
+}
+
+// Сжимает блок в ctx.packed; true — выгоднее хранить блок как есть
+static bool packFrame(const Codec& codec, const uint8_t* raw, size_t rawSize,
+                      const StreamOptions& options, CodecContext& ctx) {
+    CodecParams params;
+    params.level = options.level;
+    params.dictionary = streamDictionary(codec, options);
+    ctx.packed.clear();
+    codec.compress(raw, rawSize, ctx.packed, params, &ctx);
+    return ctx.packed.size() >= rawSize;
+}
+
+// Кадр с дедупликацией: число записей рецепта, рецепт, затем новые
+// фрагменты — сжатые кодеком или как есть (STORED_FLAG). Собирает
+// полезную нагрузку в payload; true — новые фрагменты хранятся как есть.
+static bool packDedupFrame(const Codec& codec, const vector<uint32_t>& recipe,
+                           const vector<uint8_t>& unique, const StreamOptions& options,
+                           CodecContext& ctx, vector<uint8_t>& payload) {
+    payload.resize(4 + 4 * recipe.size());
+    putU32(payload.data(), static_cast<uint32_t>(recipe.size()));
+    for (size_t i = 0; i < recipe.size(); ++i) putU32(payload.data() + 4 + 4 * i, recipe[i]);
+
+    // Блок целиком из ссылок: кодеку нечего сжимать
+    bool stored = unique.empty() || packFrame(codec, unique.data(), unique.size(), options, ctx);
+    const vector<uint8_t>& body = stored ? unique : ctx.packed;
+    payload.insert(payload.end(), body.begin(), body.end());
+    return stored;
+}
+
+static void makeFrameHeader(uint8_t* frameHeader, size_t rawSize, size_t payloadSize, bool stored) {
+    putU32(frameHeader, static_cast<uint32_t>(rawSize));
+    putU32(frameHeader + 4, static_cast<uint32_t>(payloadSize) | (stored ? STORED_FLAG : 0));
+}
+
+// Наибольшая полезная нагрузка кадра: рецепт дедупликации может
+// немного превысить исходный размер
+static size_t maxPayloadSize(size_t rawSize, bool dedup) {
+    return dedup ? rawSize + 4 + 4 * dedupMaxEntries(rawSize) : rawSize;
+}
+
+// Разбирает заголовок кадра; false — завершающий кадр
+static bool parseFrameHeader(const uint8_t* frameHeader, const StreamHeader& h,
+                             size_t& rawSize, size_t& payloadSize, bool& stored) {
+    rawSize = getU32(frameHeader);
+    uint32_t packedField = getU32(frameHeader + 4);
+    if (rawSize == 0) return false;
+    payloadSize = packedField & ~STORED_FLAG;
+    stored = (packedField & STORED_FLAG) != 0;
+    if (rawSize > h.blockSize || payloadSize > maxPayloadSize(rawSize, h.hasDedup)) {
+        throw runtime_error("corrupt frame header");
+    }
+    return true;
+}
+
+// Распаковывает кадр, дописывая его в out. Кодек получает rawSize как
+// предел: повреждённый кадр не раздувает out сверх заявленного размера
+static bool unpackFrame(const Codec& codec, const uint8_t* payload, size_t payloadSize,
+                        bool stored, size_t rawSize, const Dictionary* dict, vector<uint8_t>& out) {
+    size_t start = out.size();
+    CodecParams params;
+    params.dictionary = dict;
+    if (stored) {
+        if (payloadSize != rawSize) return false;
+        out.insert(out.end(), payload, payload + payloadSize);
+    } else if (!codec.decompress(payload, payloadSize, out, rawSize, params)) {
+        return false;
+    }
+    return out.size() - start == rawSize;
+}
+
+// Разбирает рецепт кадра с дедупликацией и распаковывает новые фрагменты
+// в unique. Сборку по рецепту делает DedupDecoder строго по порядку кадров.
+static bool unpackDedupFrame(const Codec& codec, const uint8_t* payload, size_t payloadSize,
+                             bool stored, size_t rawSize, const Dictionary* dict,
+                             vector<uint32_t>& recipe, vector<uint8_t>& unique) {
+    if (payloadSize < 4) return false;
+    size_t count = getU32(payload);
+    if (count > dedupMaxEntries(rawSize) || (payloadSize - 4) / 4 < count) return false;
+
+    recipe.resize(count);
+    size_t uniqueSize = 0;
+    for (size_t i = 0; i < count; ++i) {
+        recipe[i] = getU32(payload + 4 + 4 * i);
+        if (!(recipe[i] & DEDUP_REF_FLAG)) uniqueSize += recipe[i];
+    }
+    if (uniqueSize > rawSize) return false;
+
+    size_t head = 4 + 4 * count;
+    unique.clear();
+    unique.reserve(uniqueSize);
+    return unpackFrame(codec, payload + head, payloadSize - head, stored, uniqueSize, dict, unique);
+}
+
+// Собирает кадр по рецепту, дописывая его в out
+static bool assembleDedupFrame(DedupDecoder& decoder, const vector<uint32_t>& recipe,
+                               const vector<uint8_t>& unique, size_t rawSize, vector<uint8_t>& out) {
+    size_t start = out.size();
+    return decoder.decode(recipe.data(), recipe.size(), unique.data(), unique.size(), out) &&
+           out.size() - start == rawSize;
+}
+
+void compressBuffer(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                    const StreamOptions& options, CodecContext& ctx) {
+    checkOptions(options);
+    const Codec& codec = findCodec(options.codec);
+
+    vector<uint8_t> header;
+    makeHeader(codec, options, header);
+    out.insert(out.end(), header.begin(), header.end());
+
+    unique_ptr<DedupEncoder> encoder;
+    if (options.dedup) encoder.reset(new DedupEncoder(options.dedupHistory));
+    DedupStats dedupStats;
+    vector<uint32_t> recipe;
+    vector<uint8_t> unique, payload;
+
+    for (size_t offset = 0; offset < size; offset += options.blockSize) {
+        size_t rawSize = min(options.blockSize, size - offset);
+        const uint8_t* raw = data + offset;
+        bool stored;
+        if (encoder) {
+            recipe.clear();
+            unique.clear();
+            encoder->encode(raw, rawSize, recipe, unique, dedupStats);
+            stored = packDedupFrame(codec, recipe, unique, options, ctx, payload);
+        } else {
+            stored = packFrame(codec, raw, rawSize, options, ctx);
+            if (stored) {
+                payload.assign(raw, raw + rawSize);
+            } else {
+                payload.swap(ctx.packed);
+            }
+        }
+
+        uint8_t frameHeader[FRAME_HEADER_SIZE];
+        makeFrameHeader(frameHeader, rawSize, payload.size(), stored);
+        out.insert(out.end(), frameHeader, frameHeader + FRAME_HEADER_SIZE);
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    out.insert(out.end(), FRAME_HEADER_SIZE, 0);
+    if (encoder) recordStats(dedupStats);
+}
+
+void decompressBuffer(const uint8_t* data, size_t size, vector<uint8_t>& out,
+                      const Dictionary* dict) {
+    if (size < HEADER_SIZE) throw runtime_error("not a compressed stream (bad magic)");
+    StreamHeader h = parseHeader(data);
+    size_t pos = HEADER_SIZE;
+    if (size - pos < headerExtraSize(h)) throw runtime_error("truncated header");
+    dict = parseHeaderExtras(h, data + pos, dict);
+    pos += headerExtraSize(h);
+
+    unique_ptr<DedupDecoder> decoder;
+    if (h.hasDedup) decoder.reset(new DedupDecoder(h.dedupHistory));
+    vector<uint32_t> recipe;
+    vector<uint8_t> unique;
+
+    while (true) {
+        if (size - pos < FRAME_HEADER_SIZE) {
+            throw runtime_error("truncated stream: missing end frame");
+        }
+        size_t rawSize, payloadSize;
+        bool stored;
+        if (!parseFrameHeader(data + pos, h, rawSize, payloadSize, stored)) break;
+        pos += FRAME_HEADER_SIZE;
+        if (size - pos < payloadSize) throw runtime_error("truncated frame payload");
+        bool ok = decoder
+            ? unpackDedupFrame(*h.codec, data + pos, payloadSize, stored, rawSize, dict,
+                               recipe, unique) &&
+                  assembleDedupFrame(*decoder, recipe, unique, rawSize, out)
+            : unpackFrame(*h.codec, data + pos, payloadSize, stored, rawSize, dict, out);
+        if (!ok) throw runtime_error("corrupt frame data");
+        pos += payloadSize;
+    }
+}
+
+struct Frame {
+    vector<uint8_t> raw;
+    size_t rawSize = 0;
+    vector<uint8_t> packed;
+    bool stored = false;
+    bool ok = true;
+    // Только при дедупликации
+    vector<uint32_t> recipe;
+    vector<uint8_t> unique;
+};
+
+void compressStream(istream& in, ostream& out, const StreamOptions& requested) {
+    checkOptions(requested);
+    const StreamOptions options = fitMemoryLimit(requested);
+    const Codec& codec = findCodec(options.codec);
+    const unsigned threads = options.threads;
+    IOStats io;
+    DedupStats dedupStats;
+
+    vector<uint8_t> header;
+    makeHeader(codec, options, header);
+    writeAll(out, header.data(), header.size(), io);
+
+    // Пул и контексты живут весь поток: таблицы кодеков не
+    // перевыделяются на каждый блок
+    unique_ptr<WorkerPool> pool;
+    if (threads > 1) pool.reset(new WorkerPool(threads));
+    vector<CodecContext> contexts(threads);
+    // Индекс фрагментов общий для всех блоков, поэтому работает
+    // последовательно, а сжатие новых фрагментов — в пуле
+    unique_ptr<DedupEncoder> encoder;
+    if (options.dedup) encoder.reset(new DedupEncoder(options.dedupHistory));
+
+    vector<Frame> frames(threads);
+    for (auto& f : frames) f.raw.resize(options.blockSize);
+
+    bool eof = false;
+    while (!eof) {
+        // Партия из threads блоков
+        size_t count = 0;
+        while (count < threads) {
+            Frame& f = frames[count];
+            f.rawSize = readFully(in, f.raw.data(), options.blockSize, io);
+            if (f.rawSize > 0) ++count;
+            if (f.rawSize < options.blockSize) {
+                eof = true;
+                break;
+            }
+        }
+
+        if (encoder) {
+            for (size_t i = 0; i < count; ++i) {
+                Frame& f = frames[i];
+                f.recipe.clear();
+                f.unique.clear();
+                encoder->encode(f.raw.data(), f.rawSize, f.recipe, f.unique, dedupStats);
+            }
+        }
+
+        runBatch(count, pool.get(), [&](size_t i, unsigned worker) {
+            Frame& f = frames[i];
+            CodecContext& ctx = contexts[worker];
+            if (encoder) {
+                f.stored = packDedupFrame(codec, f.recipe, f.unique, options, ctx, f.packed);
+                return;
+            }
+            f.stored = packFrame(codec, f.raw.data(), f.rawSize, options, ctx);
+            if (!f.stored) f.packed.swap(ctx.packed);
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            const Frame& f = frames[i];
+            // С дедупликацией packed всегда содержит рецепт
+            bool raw = f.stored && !encoder;
+            const uint8_t* payload = raw ? f.raw.data() : f.packed.data();
+            size_t payloadSize = raw ? f.rawSize : f.packed.size();
+
+            uint8_t frameHeader[FRAME_HEADER_SIZE];
+            makeFrameHeader(frameHeader, f.rawSize, payloadSize, f.stored);
+            writeAll(out, frameHeader, FRAME_HEADER_SIZE, io);
+            writeAll(out, payload, payloadSize, io);
+        }
+    }
+
+    // Завершающий пустой кадр
+    uint8_t endFrame[FRAME_HEADER_SIZE] = {};
+    writeAll(out, endFrame, FRAME_HEADER_SIZE, io);
+    {
+        StageTimer t(io.writeMs);
+        out.flush();
+    }
+    if (encoder) recordStats(dedupStats);
+    recordStats(io);
+}
+
+void decompressStream(istream& in, ostream& out, unsigned threads, const Dictionary* dict,
+                      size_t memoryLimit) {
+    threads = max(1u, threads);
+    IOStats io;
+
+    uint8_t header[STREAM_MAX_HEADER_SIZE];
+    if (readFully(in, header, HEADER_SIZE, io) != HEADER_SIZE) {
+        throw runtime_error("not a compressed stream (bad magic)");
+    }
+    StreamHeader h = parseHeader(header);
+    size_t extraSize = headerExtraSize(h);
+    if (readFully(in, header + HEADER_SIZE, extraSize, io) != extraSize) {
+        throw runtime_error("truncated header");
+    }
+    dict = parseHeaderExtras(h, header + HEADER_SIZE, dict);
+
+    if (memoryLimit > 0) {
+        auto need = [&](unsigned n) { return streamMemory(*h.codec, n, h.blockSize, h.dedupHistory); };
+        while (threads > 1 && need(threads) > memoryLimit) --threads;
+        if (need(1) > memoryLimit) {
+            throw runtime_error(memoryLimitError(*h.codec, memoryLimit, h.blockSize, h.dedupHistory));
+        }
+    }
+
+    unique_ptr<WorkerPool> pool;
+    if (threads > 1) pool.reset(new WorkerPool(threads));
+    unique_ptr<DedupDecoder> decoder;
+    if (h.hasDedup) decoder.reset(new DedupDecoder(h.dedupHistory));
+
+    vector<Frame> frames(threads);
+    bool end = false;
+    while (!end) {
+        size_t count = 0;
+        while (count < threads) {
+            uint8_t frameHeader[FRAME_HEADER_SIZE];
+            if (readFully(in, frameHeader, FRAME_HEADER_SIZE, io) != FRAME_HEADER_SIZE) {
+                throw runtime_error("truncated stream: missing end frame");
+            }
+            size_t rawSize, payloadSize;
+            bool stored;
+            if (!parseFrameHeader(frameHeader, h, rawSize, payloadSize, stored)) {
+                end = true;
+                break;
+            }
+
+            Frame& f = frames[count++];
+            f.rawSize = rawSize;
+            f.stored = stored;
+            f.packed.resize(payloadSize);
+            if (readFully(in, f.packed.data(), payloadSize, io) != payloadSize) {
+                throw runtime_error("truncated frame payload");
+            }
+        }
+
+        runBatch(count, pool.get(), [&](size_t i, unsigned) {
+            Frame& f = frames[i];
+            if (decoder) {
+                f.ok = unpackDedupFrame(*h.codec, f.packed.data(), f.packed.size(), f.stored,
+                                        f.rawSize, dict, f.recipe, f.unique);
+                return;
+            }
+            f.raw.clear();
+            f.raw.reserve(f.rawSize);
+            f.ok = unpackFrame(*h.codec, f.packed.data(), f.packed.size(), f.stored,
+                               f.rawSize, dict, f.raw);
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            Frame& f = frames[i];
+            if (f.ok && decoder) {
+                f.raw.clear();
+                f.raw.reserve(f.rawSize);
+                f.ok = assembleDedupFrame(*decoder, f.recipe, f.unique, f.rawSize, f.raw);
+            }
+            if (!f.ok) throw runtime_error("corrupt frame data");
+            writeAll(out, f.raw.data(), f.raw.size(), io);
+        }
+    }
+
+    {
+        StageTimer t(io.writeMs);
+        out.flush();
+    }
+    recordStats(io);
+}
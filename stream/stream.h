@@ -0,0 +1,82 @@
+// stream.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../codec/codec.h"
+#include "../dedup/dedup.h"
+#include "../dict/dict.h"
+#include "../pool/pool.h"
+
+struct StreamOptions {
+    CodecId codec = CodecId::LZ77;
+    int level = CODEC_DEFAULT_LEVEL;
+    unsigned threads = 1;
+    size_t blockSize = size_t(1) << 20;
+    const Dictionary* dictionary = nullptr; // Обученный словарь (-D)
+    size_t memoryLimit = 0;                 // Бюджет кучи, байт (--memory-limit); 0 — без ограничения
+    bool dedup = false;                     // Дедупликация фрагментов перед кодеком (--dedup)
+    size_t dedupHistory = DEDUP_DEFAULT_HISTORY; // Байт новых фрагментов, на которые можно сослаться
+};
+
+// Заголовок контейнера без необязательных полей
+const size_t STREAM_HEADER_SIZE = 12;
+// Заголовок со всеми необязательными полями: id словаря, история дедупликации
+const size_t STREAM_MAX_HEADER_SIZE = STREAM_HEADER_SIZE + 8;
+
+// Меньше этого блок не делается даже под жёстким бюджетом
+const size_t STREAM_MIN_BLOCK_SIZE = size_t(4) << 10;
+// До этого размера блок уменьшается раньше, чем число потоков
+const size_t STREAM_PREFERRED_MIN_BLOCK_SIZE = size_t(256) << 10;
+
+// Кодек из реестра; std::runtime_error, если такой id не зарегистрирован
+const Codec& findCodec(CodecId id);
+
+// Параметры сжатого потока, нужные до распаковки (например, для оценки памяти)
+struct StreamInfo {
+    CodecId codec;
+    size_t blockSize;
+    size_t dedupHistory; // 0 — поток без дедупликации
+};
+
+// Разбирает начало контейнера (до STREAM_MAX_HEADER_SIZE байт);
+// std::runtime_error, если это не контейнер или заголовок обрезан
+StreamInfo readStreamInfo(const uint8_t* header, size_t size);
+
+// Оценка пика памяти потока: на каждый из threads потоков исходный блок,
+// сжатый кадр и рабочая память кодека, плюс постоянные буферы.
+// dedupHistory > 0 добавляет новые фрагменты блока и историю дедупликации.
+size_t streamMemory(const Codec& codec, unsigned threads, size_t blockSize,
+                    size_t dedupHistory = 0);
+
+// Параметры, укладывающиеся в options.memoryLimit: сначала история
+// дедупликации уменьшается до DEDUP_MIN_HISTORY, блок — до
+// STREAM_PREFERRED_MIN_BLOCK_SIZE, затем число потоков, затем блок до
+// STREAM_MIN_BLOCK_SIZE. std::runtime_error, если не хватает и этого.
+StreamOptions fitMemoryLimit(const StreamOptions& options);
+
+// Контейнер целиком в памяти (пакетный режим): тот же формат, что у
+// compressStream, блоки сжимаются последовательно в контексте ctx.
+// Вход и результат целиком в памяти, поэтому memoryLimit здесь не
+// применяется. Ошибки формата — std::runtime_error.
+void compressBuffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                    const StreamOptions& options, CodecContext& ctx);
+void decompressBuffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out,
+                      const Dictionary* dict = nullptr);
+
+// Потоковый контейнер: заголовок с магией и кодеком, затем кадры по
+// blockSize байт. Данные читаются и пишутся по мере поступления, без
+// промежуточных файлов; блоки одной партии сжимаются в пуле из threads
+// потоков. Блок и потоки подгоняются под memoryLimit (fitMemoryLimit).
+// Ошибки формата и ввода-вывода — std::runtime_error.
+void compressStream(std::istream& in, std::ostream& out, const StreamOptions& options);
+// Кодек определяется по заголовку; если поток сжат со словарём,
+// dict должен иметь тот же id. Размер блока задан заголовком, поэтому
+// под memoryLimit уменьшается только число потоков.
+void decompressStream(std::istream& in, std::ostream& out, unsigned threads,
+                      const Dictionary* dict = nullptr, size_t memoryLimit = 0);